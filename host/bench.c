@@ -0,0 +1,317 @@
+/**
+ * @file bench.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Drawing benchmark on the simulated panel
+ *
+ * Times the bm drawing primitives and the device screens, then draws each once more and refreshes to count the bus
+ * traffic it causes. The refresh is partial without the periodic full refresh so only the drawn windows are sent.
+ * Peak stack of a draw is found by running it on a painted stack of its own and looking for the deepest byte changed,
+ * exits non-zero when a draw uses more than its bound.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "bm.h"
+#include "screens.h"
+#include "uc8151c.h"
+#include "uc8151c_sim.h"
+#include "ui.h"
+
+/* MACROS ****************************************/
+
+#define BENCH_ITERATIONS (1000)
+#define BENCH_PIXELS (32)
+#define BENCH_STACK (32 * 1024)
+#define BENCH_STACK_PAINT (0xa5)
+
+/**
+ * @brief Most stack a draw may use on the host in the default Release build, glibc vsnprintf alone takes about 2 KB
+ *
+ */
+#define BENCH_STACK_BUDGET (4096)
+
+/**
+ * @brief Most stack bm_qr_printf() may use, vsnprintf, the qrcodegen buffer of the largest version and the encoder
+ *
+ */
+#define BENCH_STACK_QR (3584)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Benchmark case
+ *
+ */
+typedef struct {
+    const char* name; ///< Case name
+    void (*run)(); ///< Draw once
+    uint16_t ops; ///< Operations per draw
+    const char* unit; ///< Operation name
+    size_t stack; ///< Most stack a draw may use
+} bench_t;
+
+/* LOCAL VARIABLES ****************************************/
+
+/**
+ * @brief Bitmap for the pixel case
+ *
+ */
+static uint8_t bench_bm[BENCH_PIXELS * BENCH_PIXELS / 8];
+
+/**
+ * @brief Stack the draw of a case runs on to find its peak
+ *
+ */
+static uint8_t bench_stack[BENCH_STACK] __attribute__((aligned(16)));
+
+/**
+ * @brief Case drawn on bench_stack
+ *
+ */
+static const bench_t* bench_stack_case;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Monotonic time
+ *
+ * @return uint64_t ns
+ */
+static uint64_t bench_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Draw a case on the painted stack, the context entry
+ *
+ */
+static void bench_stack_entry()
+{
+    bench_stack_case->run();
+}
+
+/**
+ * @brief Peak stack of one draw
+ *
+ * The draw runs on a stack of its own painted beforehand, the deepest byte changed is the peak.
+ *
+ * @param bench case
+ * @return size_t bytes of stack used
+ */
+static size_t bench_stack_used(const bench_t* bench)
+{
+    ucontext_t caller;
+    ucontext_t draw;
+    size_t i = 0;
+
+    memset(bench_stack, BENCH_STACK_PAINT, sizeof(bench_stack));
+    getcontext(&draw);
+    draw.uc_stack.ss_sp = bench_stack;
+    draw.uc_stack.ss_size = sizeof(bench_stack);
+    draw.uc_link = &caller;
+    makecontext(&draw, bench_stack_entry, 0);
+    bench_stack_case = bench;
+    swapcontext(&caller, &draw);
+
+    // Stack grows down from the end
+    while (i < sizeof(bench_stack) && BENCH_STACK_PAINT == bench_stack[i]) {
+        i++;
+    }
+    return sizeof(bench_stack) - i;
+}
+
+/**
+ * @brief Every pixel of a small bitmap
+ *
+ */
+static void bench_pixel()
+{
+    for (uint16_t x = 0; x < BENCH_PIXELS; x++) {
+        for (uint16_t y = 0; y < BENCH_PIXELS; y++) {
+            bm_draw_pixel(bench_bm, BENCH_PIXELS, BENCH_PIXELS, x, y, (x ^ y) & 1);
+        }
+    }
+}
+
+/**
+ * @brief Address line in the small packed font
+ *
+ */
+static void bench_font_small()
+{
+    bm_font_draw_string(BM_FONT_SMALL, 0, UC8151_HEIGHT - 8, "http://" SCREENS_ADDR);
+}
+
+/**
+ * @brief Clock in the run-length font
+ *
+ */
+static void bench_font_mono()
+{
+    bm_font_printf(BM_FONT_MONOSPACE, 96, 64, "%02d:%02d", 12, 34);
+}
+
+/**
+ * @brief Address QR code, cached after the first draw
+ *
+ */
+static void bench_qr()
+{
+    bm_qr_printf(0, 32, "http://%s", SCREENS_ADDR);
+}
+
+/**
+ * @brief QR code with new text every draw so it is always encoded
+ *
+ */
+static void bench_qr_encode()
+{
+    static uint8_t host = 0;
+    bm_qr_printf(0, 32, "http://192.168.1.%u", host++);
+}
+
+/**
+ * @brief Whole run screen, the widgets are forgotten first as after the setup screen
+ *
+ */
+static void bench_run()
+{
+    ui_init();
+    screens_run(12, 34);
+}
+
+/**
+ * @brief Run screen with the next minute every draw
+ *
+ */
+static void bench_minute()
+{
+    static uint16_t min = 0;
+    screens_run(min / 60 % 24, min % 60);
+    min++;
+}
+
+/**
+ * @brief Thermostat button with the next setting every draw
+ *
+ */
+static void bench_therm()
+{
+    static uint8_t therm = 0;
+    screens_therm(15 + therm++ % 16);
+}
+
+/**
+ * @brief Mode button with the next mode every draw
+ *
+ */
+static void bench_mode()
+{
+    static const bm_asset_t modes[] = { BM_ASSET_NO_SIGN, BM_ASSET_CLOCK, BM_ASSET_RADIO_ON };
+    static uint8_t mode = 0;
+    screens_mode(modes[mode++ % 3]);
+}
+
+/**
+ * @brief Cases in report order
+ *
+ */
+static const bench_t bench_cases[] = {
+    { "pixel", bench_pixel, BENCH_PIXELS * BENCH_PIXELS, "pixel", BENCH_STACK_BUDGET },
+    { "font_small", bench_font_small, sizeof("http://" SCREENS_ADDR) - 1, "glyph", BENCH_STACK_BUDGET },
+    { "font_mono", bench_font_mono, 5, "glyph", BENCH_STACK_BUDGET },
+    { "qr_printf", bench_qr, 1, "code", BENCH_STACK_QR },
+    { "qr_encode", bench_qr_encode, 1, "code", BENCH_STACK_QR },
+    { "setup", screens_setup, 1, "screen", BENCH_STACK_BUDGET },
+    { "run", bench_run, 1, "screen", BENCH_STACK_BUDGET },
+    { "minute", bench_minute, 1, "screen", BENCH_STACK_BUDGET },
+    { "therm", bench_therm, 1, "screen", BENCH_STACK_BUDGET },
+    { "mode", bench_mode, 1, "screen", BENCH_STACK_BUDGET },
+};
+
+/**
+ * @brief Time a case and count the bus traffic of one draw
+ *
+ * @param bench case
+ * @param iterations draws to time
+ * @return true the draw used more stack than its bound
+ * @return false
+ */
+static bool bench_case(const bench_t* bench, uint32_t iterations)
+{
+    uc8151_sim_stats_t stats;
+    size_t stack;
+
+    // Once untimed so the library calls of the draw are bound before the stack is measured
+    bench->run();
+
+    uint64_t start = bench_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        bench->run();
+    }
+    uint64_t ns = bench_ns() - start;
+
+    // Flush what the timed draws left, then send one draw
+    uc8151_refresh();
+    uc8151_sim_stats_reset();
+    stack = bench_stack_used(bench);
+    uc8151_refresh();
+    uc8151_sim_stats(&stats);
+
+    printf("%-12s %10.1f ns/%-6s %10.1f us/draw %6zu stack %6u bytes %4u commands %4u transfers\n", bench->name,
+        (double)ns / iterations / bench->ops, bench->unit, (double)ns / iterations / 1000, stack, stats.bytes,
+        stats.commands, stats.transfers);
+
+    bool err = bench->stack < stack;
+    if (err) {
+        printf("%s uses more than %zu bytes of stack\n", bench->name, bench->stack);
+    }
+    return err;
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Main
+ *
+ * @param argc
+ * @param argv iterations per case, 1000 by default
+ * @return int
+ */
+int main(int argc, char* argv[])
+{
+    uint32_t iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_ITERATIONS;
+    if (!iterations) {
+        iterations = 1;
+    }
+
+    uc8151_setup();
+    uc8151_init();
+    uc8151_set_update(UC8151_UPDATE_PARTIAL, 0);
+    bm_init(uc8151_draw_bitmap);
+
+    // Get the waveform and display RAM loaded
+    uc8151_refresh();
+
+    bool err = false;
+    for (size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++) {
+        err |= bench_case(&bench_cases[i], iterations);
+    }
+
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
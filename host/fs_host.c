@@ -0,0 +1,138 @@
+/**
+ * @file fs_host.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Host file system serving the fs directory like makefsdata does
+ *
+ * Files are loaded once and prefixed with the same HTTP header makefsdata adds.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/apps/fs.h"
+
+/* MACROS ****************************************/
+
+#define FS_HOST_FILES_MAX (32)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Loaded file
+ *
+ */
+typedef struct {
+    char name[64]; ///< Path from the fs root
+    char* data; ///< Header and content
+    int len; ///< Size of data
+} fs_host_file_t;
+
+/* LOCAL VARIABLES ****************************************/
+
+/**
+ * @brief Files loaded so far
+ *
+ */
+static fs_host_file_t fs_host_files[FS_HOST_FILES_MAX];
+
+/**
+ * @brief Number of loaded files
+ *
+ */
+static int fs_host_count = 0;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Load a file from the fs directory with the makefsdata header
+ *
+ * @param name path from the fs root
+ * @return fs_host_file_t* NULL if not found
+ */
+static fs_host_file_t* fs_host_load(const char* name)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s%s", HOST_FS_DIR, name);
+
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    const char* type = strstr(name, ".html") ? "text/html" : "text/plain";
+    char header[128];
+    int header_len = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nServer: lwIP/pre-0.6 (http://www.sics.se/~adam/lwip/)\r\nContent-type: %s\r\n\r\n", type);
+
+    fs_host_file_t* file = &fs_host_files[fs_host_count];
+    file->data = malloc(header_len + size);
+    memcpy(file->data, header, header_len);
+    if (size != (long)fread(file->data + header_len, 1, size, f)) {
+        free(file->data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    file->len = header_len + size;
+    snprintf(file->name, sizeof(file->name), "%s", name);
+    fs_host_count++;
+    return file;
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Open a file
+ *
+ * @param file file handle
+ * @param name path from the fs root
+ * @return err_t
+ */
+err_t fs_open(struct fs_file* file, const char* name)
+{
+    fs_host_file_t* found = NULL;
+
+    if (!file || !name) {
+        return ERR_VAL;
+    }
+
+    for (int i = 0; !found && i < fs_host_count; i++) {
+        if (0 == strcmp(fs_host_files[i].name, name)) {
+            found = &fs_host_files[i];
+        }
+    }
+    if (!found && FS_HOST_FILES_MAX > fs_host_count) {
+        found = fs_host_load(name);
+    }
+    if (!found) {
+        return ERR_VAL;
+    }
+
+    memset(file, 0, sizeof(*file));
+    file->data = found->data;
+    file->len = found->len;
+    file->index = found->len;
+    file->flags = FS_FILE_FLAGS_HEADER_INCLUDED;
+    return ERR_OK;
+}
+
+/**
+ * @brief Close a file
+ *
+ * @param file file handle
+ */
+void fs_close(struct fs_file* file)
+{
+    (void)file;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file gpio.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Host stand-in for the Pico SDK GPIO used by the buttons
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __HOST_GPIO_H__
+#define __HOST_GPIO_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t events);
+
+#define GPIO_IN (false)
+
+#define GPIO_IRQ_EDGE_FALL (0x4)
+#define GPIO_IRQ_EDGE_RISE (0x8)
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_pull_up(uint gpio);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback);
+bool gpio_get(uint gpio);
+
+#endif /* __HOST_GPIO_H__ */
@@ -0,0 +1,17 @@
+/**
+ * @file sync.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Host stand-in for the Pico SDK barriers
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __HOST_SYNC_H__
+#define __HOST_SYNC_H__
+
+#define __dmb() __sync_synchronize()
+
+#endif /* __HOST_SYNC_H__ */
@@ -0,0 +1,19 @@
+/**
+ * @file timer.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Host stand-in for the Pico SDK microsecond timer
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __HOST_TIMER_H__
+#define __HOST_TIMER_H__
+
+#include <stdint.h>
+
+uint32_t time_us_32();
+
+#endif /* __HOST_TIMER_H__ */
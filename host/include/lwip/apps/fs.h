@@ -0,0 +1,36 @@
+/**
+ * @file fs.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Host stand-in for the lwIP HTTPD file system used by the display code
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __HOST_FS_H__
+#define __HOST_FS_H__
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+
+#define ERR_OK (0)
+#define ERR_VAL (-6)
+
+#define FS_FILE_FLAGS_HEADER_INCLUDED (0x01)
+#define FS_FILE_FLAGS_HEADER_PERSISTENT (0x02)
+
+struct fs_file {
+    const char* data;
+    int len;
+    int index;
+    void* pextension;
+    uint8_t flags;
+};
+
+err_t fs_open(struct fs_file* file, const char* name);
+void fs_close(struct fs_file* file);
+
+#endif /* __HOST_FS_H__ */
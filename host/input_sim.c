@@ -0,0 +1,240 @@
+/**
+ * @file input_sim.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Simulated clock, button pins and scheduler timer behind the input module
+ *
+ * The pins are pulled up and read LOW when pressed. Changing a pin level calls the GPIO interrupt callback straight
+ * away at the simulated time, the scheduler only records the events posted and the timer last started or stopped.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stddef.h>
+
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "input_sim.h"
+#include "sched.h"
+
+/* MACROS ****************************************/
+
+#define SIM_GPIO_MAX (30)
+
+/* LOCAL VARIABLES ****************************************/
+
+/**
+ * @brief Microsecond timer
+ *
+ */
+static uint32_t sim_clock = 0;
+
+/**
+ * @brief Pin levels, HIGH when released
+ *
+ */
+static bool sim_level[SIM_GPIO_MAX];
+
+/**
+ * @brief Pins with the interrupt enabled
+ *
+ */
+static bool sim_irq[SIM_GPIO_MAX];
+
+/**
+ * @brief GPIO interrupt callback
+ *
+ */
+static gpio_irq_callback_t sim_callback = NULL;
+
+/**
+ * @brief Scheduler timer running and its delay
+ *
+ */
+static bool sim_timer_run = false;
+static uint32_t sim_timer_ms = 0;
+
+/**
+ * @brief Events posted
+ *
+ */
+static uint32_t sim_posts = 0;
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Set the microsecond timer
+ *
+ * @param us
+ */
+void input_sim_clock(uint32_t us)
+{
+    sim_clock = us;
+}
+
+/**
+ * @brief Press or release a button pin, an edge runs the interrupt
+ *
+ * @param gpio
+ * @param down
+ */
+void input_sim_pin(uint32_t gpio, bool down)
+{
+    if (gpio < SIM_GPIO_MAX && sim_level[gpio] == down) {
+        sim_level[gpio] = !down;
+        if (sim_irq[gpio] && sim_callback) {
+            sim_callback(gpio, down ? GPIO_IRQ_EDGE_FALL : GPIO_IRQ_EDGE_RISE);
+        }
+    }
+}
+
+/**
+ * @brief Scheduler timer state
+ *
+ * @param ms delay it was last started with
+ * @return true running
+ * @return false
+ */
+bool input_sim_timer(uint32_t* ms)
+{
+    *ms = sim_timer_ms;
+    return sim_timer_run;
+}
+
+/**
+ * @brief Events posted so far
+ *
+ * @return uint32_t
+ */
+uint32_t input_sim_posts()
+{
+    return sim_posts;
+}
+
+/**
+ * @brief Microsecond timer
+ *
+ * @return uint32_t
+ */
+uint32_t time_us_32()
+{
+    return sim_clock;
+}
+
+/**
+ * @brief Take a pin, released
+ *
+ * @param gpio
+ */
+void gpio_init(uint gpio)
+{
+    if (gpio < SIM_GPIO_MAX) {
+        sim_level[gpio] = true;
+    }
+}
+
+/**
+ * @brief Pins are only inputs here
+ *
+ * @param gpio
+ * @param out
+ */
+void gpio_set_dir(uint gpio, bool out)
+{
+    (void)gpio;
+    (void)out;
+}
+
+/**
+ * @brief Pins are always pulled up here
+ *
+ * @param gpio
+ */
+void gpio_pull_up(uint gpio)
+{
+    (void)gpio;
+}
+
+/**
+ * @brief Enable the edge interrupt of a pin
+ *
+ * @param gpio
+ * @param events
+ * @param enabled
+ * @param callback shared by all pins
+ */
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback)
+{
+    (void)events;
+    if (gpio < SIM_GPIO_MAX) {
+        sim_irq[gpio] = enabled;
+        sim_callback = callback;
+    }
+}
+
+/**
+ * @brief Pin level
+ *
+ * @param gpio
+ * @return true HIGH
+ * @return false LOW
+ */
+bool gpio_get(uint gpio)
+{
+    return gpio < SIM_GPIO_MAX ? sim_level[gpio] : true;
+}
+
+/**
+ * @brief Count the event
+ *
+ * @param type
+ * @param id
+ * @param data
+ * @return true
+ * @return false
+ */
+bool sched_post(sched_evt_type_t type, uint32_t id, uint32_t data)
+{
+    (void)type;
+    (void)id;
+    (void)data;
+    sim_posts++;
+    return false;
+}
+
+/**
+ * @brief Record the timer started
+ *
+ * @param timer
+ * @param ms
+ * @param periodic
+ * @return true
+ * @return false
+ */
+bool sched_timer_start(uint8_t timer, uint32_t ms, bool periodic)
+{
+    (void)timer;
+    (void)periodic;
+    sim_timer_run = true;
+    sim_timer_ms = ms;
+    return false;
+}
+
+/**
+ * @brief Record the timer stopped
+ *
+ * @param timer
+ * @return true
+ * @return false
+ */
+bool sched_timer_stop(uint8_t timer)
+{
+    (void)timer;
+    sim_timer_run = false;
+    return false;
+}
@@ -0,0 +1,22 @@
+/**
+ * @file input_sim.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Refer to .c file
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+#ifndef __INPUT_SIM_H__
+#define __INPUT_SIM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void input_sim_clock(uint32_t us);
+void input_sim_pin(uint32_t gpio, bool down);
+bool input_sim_timer(uint32_t* ms);
+uint32_t input_sim_posts();
+
+#endif /* __INPUT_SIM_H__ */
@@ -0,0 +1,217 @@
+/**
+ * @file inputcheck.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Debounce, long press and repeat check of the buttons on a simulated clock and pins
+ *
+ * Presses the buttons with bounce at set times and checks the events input_read() gives and the timer it asks for:
+ * bounce within the debounce time is dropped, the pin is read again once it is over, a long press comes after 600 ms
+ * and repeats every 150 ms with no burst to catch up after a stall. Runs again with the microsecond timer wrapping in
+ * the long press and in the debounce time. Exits non-zero when a check fails.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "input.h"
+#include "input_sim.h"
+
+/* MACROS ****************************************/
+
+// Button pins as wired in input.c
+#define INPUTCHECK_PIN_A (12)
+#define INPUTCHECK_PIN_C (14)
+
+#define INPUTCHECK_TIMER (3)
+
+/* LOCAL VARIABLES ****************************************/
+
+/**
+ * @brief Time of the run the steps are from in us
+ *
+ */
+static uint32_t inputcheck_base = 0;
+
+/**
+ * @brief Checks failed
+ *
+ */
+static int inputcheck_failed = 0;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Report a failed check
+ *
+ * @param ok
+ * @param ms step time
+ * @param what
+ */
+static void inputcheck(bool ok, uint32_t ms, const char* what)
+{
+    if (!ok) {
+        printf("FAIL base %u at %u ms: %s\n", inputcheck_base, ms, what);
+        inputcheck_failed++;
+    }
+}
+
+/**
+ * @brief Microsecond timer at a step of the run
+ *
+ * @param ms
+ * @return uint32_t
+ */
+static uint32_t inputcheck_us(uint32_t ms)
+{
+    return inputcheck_base + ms * 1000;
+}
+
+/**
+ * @brief Move the clock to a step and change a pin
+ *
+ * @param ms
+ * @param gpio
+ * @param down
+ */
+static void inputcheck_pin(uint32_t ms, uint32_t gpio, bool down)
+{
+    uint32_t posts = input_sim_posts();
+    input_sim_clock(inputcheck_us(ms));
+    input_sim_pin(gpio, down);
+    inputcheck(posts + 1 == input_sim_posts(), ms, "edge not posted");
+}
+
+/**
+ * @brief Move the clock to a step and read the next event, which must be the one given
+ *
+ * @param ms
+ * @param btn
+ * @param action
+ */
+static void inputcheck_event(uint32_t ms, input_btn_t btn, input_action_t action)
+{
+    input_evt_t evt;
+    input_sim_clock(inputcheck_us(ms));
+    if (input_read(&evt)) {
+        inputcheck(false, ms, "no event");
+    } else {
+        inputcheck(btn == evt.btn, ms, "event of another button");
+        inputcheck(action == evt.action, ms, "other action");
+        inputcheck(inputcheck_us(ms) == evt.time, ms, "event time");
+    }
+}
+
+/**
+ * @brief Move the clock to a step, there must be no event
+ *
+ * @param ms
+ */
+static void inputcheck_none(uint32_t ms)
+{
+    input_evt_t evt;
+    input_sim_clock(inputcheck_us(ms));
+    inputcheck(input_read(&evt), ms, "unexpected event");
+}
+
+/**
+ * @brief Timer asked for after the last read
+ *
+ * @param ms step time
+ * @param run timer running
+ * @param wait delay it must be started with
+ */
+static void inputcheck_timer(uint32_t ms, bool run, uint32_t wait)
+{
+    uint32_t timer_ms;
+    bool timer_run = input_sim_timer(&timer_ms);
+    inputcheck(run == timer_run, ms, run ? "timer not running" : "timer running");
+    inputcheck(!run || wait == timer_ms, ms, "timer delay");
+}
+
+/**
+ * @brief Press, bounce, hold and release in turn from a base time
+ *
+ * @param base us
+ */
+static void inputcheck_run(uint32_t base)
+{
+    inputcheck_base = base;
+
+    // First edge taken at once, long press timed
+    inputcheck_pin(0, INPUTCHECK_PIN_A, true);
+    inputcheck_event(0, INPUT_BTN_A, INPUT_PRESS);
+    inputcheck_none(0);
+    inputcheck_timer(0, true, 600);
+
+    // Bounce within the debounce time dropped, timer for the rest of it
+    inputcheck_pin(2, INPUTCHECK_PIN_A, false);
+    inputcheck_pin(4, INPUTCHECK_PIN_A, true);
+    inputcheck_none(5);
+    inputcheck_timer(5, true, 15);
+
+    // Pin read again once over, still pressed
+    inputcheck_none(20);
+    inputcheck_timer(20, true, 580);
+
+    // Long press then repeats
+    inputcheck_none(599);
+    inputcheck_event(600, INPUT_BTN_A, INPUT_LONG);
+    inputcheck_none(600);
+    inputcheck_timer(600, true, 150);
+    inputcheck_none(749);
+    inputcheck_event(750, INPUT_BTN_A, INPUT_REPEAT);
+    inputcheck_event(900, INPUT_BTN_A, INPUT_REPEAT);
+
+    // One repeat after a stall, the next a repeat interval later
+    inputcheck_event(2000, INPUT_BTN_A, INPUT_REPEAT);
+    inputcheck_none(2000);
+    inputcheck_timer(2000, true, 150);
+    inputcheck_none(2149);
+    inputcheck_event(2150, INPUT_BTN_A, INPUT_REPEAT);
+
+    // Release stops the timer
+    inputcheck_pin(2200, INPUTCHECK_PIN_A, false);
+    inputcheck_event(2200, INPUT_BTN_A, INPUT_RELEASE);
+    inputcheck_none(2200);
+    inputcheck_timer(2200, false, 0);
+
+    // Bounce that settles the other way is found when the pin is read again
+    inputcheck_pin(3000, INPUTCHECK_PIN_C, true);
+    inputcheck_event(3000, INPUT_BTN_C, INPUT_PRESS);
+    inputcheck_pin(3005, INPUTCHECK_PIN_C, false);
+    inputcheck_none(3010);
+    inputcheck_timer(3010, true, 10);
+    inputcheck_event(3020, INPUT_BTN_C, INPUT_RELEASE);
+    inputcheck_none(3020);
+    inputcheck_timer(3020, false, 0);
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Main
+ *
+ * @return int
+ */
+int main()
+{
+    input_init(INPUTCHECK_TIMER);
+
+    inputcheck_run(1000000);
+
+    // Timer wraps between the long press and the first repeat
+    inputcheck_run(0u - 700000u);
+
+    // Timer wraps in the debounce time
+    inputcheck_run(0u - 3000u);
+
+    printf("%s\n", inputcheck_failed ? "Failed" : "Passed");
+    return inputcheck_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,403 @@
+/**
+ * @file jsonfuzz.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Fuzz and benchmark of the JSON parser of the web API
+ *
+ * Checks the parser against known documents, then that every document gives the same members and error whole, split
+ * at every byte and fed a byte at a time, as it would across the pieces of a request body. Random mutations of the
+ * documents are then parsed whole and a byte at a time and must agree, with every string value terminated at its
+ * length. Last the settings document and the key lookup are timed, with a strcmp chain over the same keys for
+ * comparison. Exits non-zero on the first failure.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "json.h"
+
+/* MACROS ****************************************/
+
+#define JSONFUZZ_ITERATIONS (100000)
+
+/**
+ * @brief Member log bytes
+ *
+ */
+#define JSONFUZZ_LOG_SIZE (1024)
+
+/**
+ * @brief Mutations per fuzz document
+ *
+ */
+#define JSONFUZZ_MUTATIONS (4)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Known document and what it parses to
+ *
+ */
+typedef struct {
+    const char* text; ///< Document
+    const char* members; ///< Members logged, NULL when it is an error
+} jsonfuzz_case_t;
+
+/**
+ * @brief Members and error of a parse
+ *
+ */
+typedef struct {
+    char log[JSONFUZZ_LOG_SIZE]; ///< Members as key=type:value;
+    size_t len; ///< Log bytes
+    const char* err; ///< Error, NULL for none
+    bool bad; ///< Value not terminated at its length
+} jsonfuzz_result_t;
+
+/* LOCAL VARIABLES ****************************************/
+
+/**
+ * @brief Settings keys of the device
+ *
+ */
+static const char* const jsonfuzz_names[] = {
+    "ssid", "pass", "tz", "time", "mqttaddr", "mqttusr", "mqttpwd", "mode", "therm", "timer1", "timer2"
+};
+
+static json_keys_t jsonfuzz_keys;
+
+/**
+ * @brief Settings document like the web page sends
+ *
+ */
+static const char jsonfuzz_settings[] = "{\"therm\":21,\"mode\":1,\"timer1\":\"07:30\",\"timer2\":\"22:00\","
+                                        "\"tz\":-60,\"time\":1709650800}";
+
+static const jsonfuzz_case_t jsonfuzz_cases[] = {
+    { "{}", "" },
+    { " \r\n{ }\t", "" },
+    { "{\"therm\":21}", "therm=1:21;" },
+    { "{\"ssid\":\"home\",\"pass\":\"a\\\"b\\\\c\"}", "ssid=0:home;pass=0:a\"b\\c;" },
+    { "{\"ssid\":\"\\u00e9\\u20ac\\/\\t\"}", "ssid=0:\xc3\xa9\xe2\x82\xac/\t;" },
+    { "{\"tz\":-0.5e+3,\"time\":0}", "tz=1:-0.5e+3;time=1:0;" },
+    { "{\"mode\":true,\"therm\":false,\"ssid\":null}", "mode=2:true;therm=3:false;ssid=4:null;" },
+    { "{\"unknown\":\"x\",\"therm\":1}", "therm=1:1;" },
+    { "{\"averyveryverylongkeyname\":1,\"mode\":2}", "mode=1:2;" },
+    { "{\"the\\u0072m\":5}", "therm=1:5;" },
+    { "", NULL },
+    { "{", NULL },
+    { "{\"therm\":21", NULL },
+    { "{\"therm\":21,}", NULL },
+    { "{,}", NULL },
+    { "{\"therm\" 21}", NULL },
+    { "{\"therm\":}", NULL },
+    { "{\"therm\":021}", NULL },
+    { "{\"therm\":1.}", NULL },
+    { "{\"therm\":-}", NULL },
+    { "{\"therm\":1e}", NULL },
+    { "{\"therm\":tru}", NULL },
+    { "{\"therm\":True}", NULL },
+    { "{\"therm\":{\"a\":1}}", NULL },
+    { "{\"therm\":[1]}", NULL },
+    { "{\"ssid\":\"a\nb\"}", NULL },
+    { "{\"ssid\":\"\\x\"}", NULL },
+    { "{\"ssid\":\"\\u00\"}", NULL },
+    { "{\"ssid\":\"\\u0000\"}", NULL },
+    { "{\"ssid\":\"\\ud83d\\ude00\"}", NULL },
+    { "{\"ssid\":\"0123456789012345678901234567890123456789012345678901234567890123456789012\"}", NULL },
+    { "{} {}", NULL },
+    { "[1]", NULL },
+    { "{\"therm\":1 \"mode\":2}", NULL },
+};
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Monotonic time
+ *
+ * @return uint64_t ns
+ */
+static uint64_t jsonfuzz_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Log a member
+ *
+ * @param arg jsonfuzz_result_t
+ * @param key
+ * @param type
+ * @param value
+ * @param len
+ * @return false
+ */
+static bool jsonfuzz_member(void* arg, uint8_t key, json_type_t type, const char* value, size_t len)
+{
+    jsonfuzz_result_t* result = arg;
+    if (strlen(value) != len) {
+        result->bad = true;
+    }
+    int printed = snprintf(result->log + result->len, sizeof(result->log) - result->len, "%s=%d:%s;",
+        jsonfuzz_names[key], type, value);
+    if (0 < printed) {
+        result->len += printed;
+        if (result->len >= sizeof(result->log)) {
+            result->len = sizeof(result->log) - 1;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Count a member, for timing the parser alone
+ *
+ * @param arg uint32_t count
+ * @param key
+ * @param type
+ * @param value
+ * @param len
+ * @return false
+ */
+static bool jsonfuzz_count(void* arg, uint8_t key, json_type_t type, const char* value, size_t len)
+{
+    (*(uint32_t*)arg) += key + type + len + (uint8_t)*value;
+    return false;
+}
+
+/**
+ * @brief Parse a document in pieces
+ *
+ * @param result
+ * @param text
+ * @param len
+ * @param split first piece bytes, the rest is fed in pieces of step bytes
+ * @param step
+ */
+static void jsonfuzz_parse(jsonfuzz_result_t* result, const char* text, size_t len, size_t split, size_t step)
+{
+    json_t json;
+    memset(result, 0, sizeof(*result));
+    json_init(&json, &jsonfuzz_keys, jsonfuzz_member, result);
+    if (!json_parse(&json, text, split)) {
+        for (size_t i = split; i < len && !json_parse(&json, text + i, len - i < step ? len - i : step); i += step) {
+        }
+    }
+    json_end(&json);
+    result->err = json.err;
+}
+
+/**
+ * @brief Two parses agree
+ *
+ * @param a
+ * @param b
+ * @return true
+ * @return false
+ */
+static bool jsonfuzz_same(const jsonfuzz_result_t* a, const jsonfuzz_result_t* b)
+{
+    return a->len == b->len && 0 == memcmp(a->log, b->log, a->len) && !a->err == !b->err
+        && (!a->err || 0 == strcmp(a->err, b->err)) && !a->bad && !b->bad;
+}
+
+/**
+ * @brief Known documents, whole and in pieces
+ *
+ * @return true failed
+ * @return false
+ */
+static bool jsonfuzz_cases_run()
+{
+    jsonfuzz_result_t whole;
+    jsonfuzz_result_t piece;
+
+    for (size_t i = 0; i < sizeof(jsonfuzz_cases) / sizeof(jsonfuzz_cases[0]); i++) {
+        const jsonfuzz_case_t* test = &jsonfuzz_cases[i];
+        size_t len = strlen(test->text);
+
+        jsonfuzz_parse(&whole, test->text, len, len, 1);
+        if (test->members ? (whole.err || strcmp(whole.log, test->members)) : !whole.err) {
+            printf("case %zu %s: got %s%s\n", i, test->text, whole.log, whole.err ? whole.err : "");
+            return true;
+        }
+        for (size_t split = 0; split <= len; split++) {
+            jsonfuzz_parse(&piece, test->text, len, split, len);
+            if (!jsonfuzz_same(&whole, &piece)) {
+                printf("case %zu %s: split at %zu differs\n", i, test->text, split);
+                return true;
+            }
+        }
+        jsonfuzz_parse(&piece, test->text, len, 0, 1);
+        if (!jsonfuzz_same(&whole, &piece)) {
+            printf("case %zu %s: a byte at a time differs\n", i, test->text);
+            return true;
+        }
+    }
+    printf("%zu cases parse the same whole, split and a byte at a time\n", sizeof(jsonfuzz_cases) / sizeof(jsonfuzz_cases[0]));
+    return false;
+}
+
+/**
+ * @brief Random mutations of the documents
+ *
+ * @param iterations
+ * @return true failed
+ * @return false
+ */
+static bool jsonfuzz_mutate(uint32_t iterations)
+{
+    char text[256];
+    jsonfuzz_result_t whole;
+    jsonfuzz_result_t piece;
+    uint32_t parsed = 0;
+    static const char bytes[] = "{}[]\":,\\u0123456789abcdefe+-. \t\ntruefalsenull\x01\x7f\xc3\xa9";
+
+    srand(1);
+    for (uint32_t i = 0; i < iterations; i++) {
+        const char* source = jsonfuzz_cases[rand() % (sizeof(jsonfuzz_cases) / sizeof(jsonfuzz_cases[0]))].text;
+        if (0 == i % 2) {
+            source = jsonfuzz_settings;
+        }
+        size_t len = strlen(source);
+        memcpy(text, source, len);
+
+        for (uint8_t m = 0; m < JSONFUZZ_MUTATIONS; m++) {
+            size_t pos = len ? rand() % len : 0;
+            char c = (rand() % 4) ? bytes[rand() % (sizeof(bytes) - 1)] : (char)rand();
+            switch (rand() % 3) {
+            case 0:
+                // Replace
+                if (len) {
+                    text[pos] = c;
+                }
+                break;
+            case 1:
+                // Insert
+                if (len < sizeof(text)) {
+                    memmove(text + pos + 1, text + pos, len - pos);
+                    text[pos] = c;
+                    len++;
+                }
+                break;
+            default:
+                // Delete
+                if (len) {
+                    memmove(text + pos, text + pos + 1, len - pos - 1);
+                    len--;
+                }
+                break;
+            }
+        }
+
+        jsonfuzz_parse(&whole, text, len, len, 1);
+        jsonfuzz_parse(&piece, text, len, 0, 1);
+        if (!jsonfuzz_same(&whole, &piece)) {
+            printf("mutation %u of %.*s: pieces differ\n", i, (int)len, text);
+            return true;
+        }
+        parsed += !whole.err;
+    }
+    printf("%u mutations parse the same whole and a byte at a time, %u still valid\n", iterations, parsed);
+    return false;
+}
+
+/**
+ * @brief strcmp chain over the keys, as a handler would without the hash
+ *
+ * @param name
+ * @return int8_t key index, -1 when unknown
+ */
+static int8_t jsonfuzz_strcmp(const char* name)
+{
+    for (uint8_t i = 0; i < sizeof(jsonfuzz_names) / sizeof(jsonfuzz_names[0]); i++) {
+        if (0 == strcmp(jsonfuzz_names[i], name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Time the settings document and the key lookup
+ *
+ * @param iterations
+ */
+static void jsonfuzz_bench(uint32_t iterations)
+{
+    static const char* const lookups[] = { "ssid", "timer2", "therm", "unknown" };
+    json_t json;
+    uint32_t count = 0;
+    volatile int32_t sum = 0;
+
+    uint64_t start = jsonfuzz_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        json_init(&json, &jsonfuzz_keys, jsonfuzz_count, &count);
+        json_parse(&json, jsonfuzz_settings, sizeof(jsonfuzz_settings) - 1);
+        sum += json_end(&json);
+    }
+    uint64_t ns = jsonfuzz_ns() - start;
+    sum += count;
+    printf("%-12s %10.1f ns/byte %10.1f us/document %zu bytes\n", "settings", (double)ns / iterations / (sizeof(jsonfuzz_settings) - 1),
+        (double)ns / iterations / 1000, sizeof(jsonfuzz_settings) - 1);
+
+    for (size_t l = 0; l < sizeof(lookups) / sizeof(lookups[0]); l++) {
+        const char* name = lookups[l];
+        size_t len = strlen(name);
+
+        start = jsonfuzz_ns();
+        for (uint32_t i = 0; i < iterations; i++) {
+            sum += json_key(&jsonfuzz_keys, name, len);
+        }
+        uint64_t hash = jsonfuzz_ns() - start;
+
+        start = jsonfuzz_ns();
+        for (uint32_t i = 0; i < iterations; i++) {
+            sum += jsonfuzz_strcmp(name);
+        }
+        uint64_t chain = jsonfuzz_ns() - start;
+
+        printf("%-12s %10.1f ns/hash %10.1f ns/strcmp chain\n", name, (double)hash / iterations, (double)chain / iterations);
+    }
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Main
+ *
+ * @param argc
+ * @param argv fuzz and benchmark iterations, 100000 by default
+ * @return int
+ */
+int main(int argc, char* argv[])
+{
+    uint32_t iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : JSONFUZZ_ITERATIONS;
+    if (!iterations) {
+        iterations = 1;
+    }
+
+    if (json_keys_init(&jsonfuzz_keys, jsonfuzz_names, sizeof(jsonfuzz_names) / sizeof(jsonfuzz_names[0]))) {
+        return 1;
+    }
+    printf("%zu keys in %u slots with seed %u\n", sizeof(jsonfuzz_names) / sizeof(jsonfuzz_names[0]), JSON_KEY_SLOTS,
+        jsonfuzz_keys.seed);
+
+    if (jsonfuzz_cases_run() || jsonfuzz_mutate(iterations)) {
+        return 1;
+    }
+    jsonfuzz_bench(iterations);
+
+    return 0;
+}
@@ -0,0 +1,279 @@
+/**
+ * @file lutcheck.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Register waveform check of the UC8151 driver on the simulated panel
+ *
+ * Goes through the update modes and checks the panel setting and the LUT bytes the driver sends through the bus
+ * against the waveform tables, that LUTs are only sent when the waveform changes or was lost on reset, that the
+ * periodic full refresh goes back to the OTP waveform and that a partial update of several windows is one refresh.
+ * Exits non-zero when a check fails.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uc8151c.h"
+#include "uc8151c_hal.h"
+#include "uc8151c_sim.h"
+
+/* MACROS ****************************************/
+
+#define LUTCHECK_VCOM_SIZE (44)
+#define LUTCHECK_LUT_SIZE (42)
+#define LUTCHECK_LINE_SIZE (UC8151_HEIGHT / 8)
+
+// Panel setting with the OTP and the register LUTs
+#define LUTCHECK_PSR_OTP (0b10010111)
+#define LUTCHECK_PSR_REG (0b10110111)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Expected register LUTs of a waveform
+ *
+ */
+typedef struct {
+    uint8_t vcom[LUTCHECK_VCOM_SIZE]; ///< LUT_VCOM
+    uint8_t white[LUTCHECK_LUT_SIZE]; ///< LUT_WW and LUT_BW
+    uint8_t black[LUTCHECK_LUT_SIZE]; ///< LUT_WB and LUT_BB
+} lutcheck_lut_t;
+
+/* LOCAL VARIABLES ****************************************/
+
+/**
+ * @brief Fast waveform, flash to black, shake and drive to the new level
+ *
+ */
+static const lutcheck_lut_t lutcheck_fast = {
+    .vcom = {
+        0x00, 0x04, 0x04, 0x07, 0x00, 0x01,
+        0x00, 0x0c, 0x0c, 0x00, 0x00, 0x02,
+        0x00, 0x04, 0x04, 0x07, 0x00, 0x02,
+    },
+    .white = {
+        0x54, 0x04, 0x04, 0x07, 0x00, 0x01,
+        0x60, 0x0c, 0x0c, 0x00, 0x00, 0x02,
+        0xa8, 0x04, 0x04, 0x07, 0x00, 0x02,
+    },
+    .black = {
+        0xa8, 0x04, 0x04, 0x07, 0x00, 0x01,
+        0x60, 0x0c, 0x0c, 0x00, 0x00, 0x02,
+        0x54, 0x04, 0x04, 0x07, 0x00, 0x02,
+    },
+};
+
+/**
+ * @brief Partial waveform, drive to the new level only
+ *
+ */
+static const lutcheck_lut_t lutcheck_partial = {
+    .vcom = {
+        0x00, 0x04, 0x04, 0x07, 0x00, 0x01,
+    },
+    .white = {
+        0xa8, 0x04, 0x04, 0x07, 0x00, 0x01,
+    },
+    .black = {
+        0x54, 0x04, 0x04, 0x07, 0x00, 0x01,
+    },
+};
+
+/**
+ * @brief Checks failed
+ *
+ */
+static int lutcheck_failed = 0;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Report a failed check
+ *
+ * @param ok
+ * @param step
+ * @param what
+ */
+static void lutcheck(bool ok, const char* step, const char* what)
+{
+    if (!ok) {
+        printf("FAIL %s: %s\n", step, what);
+        lutcheck_failed++;
+    }
+}
+
+/**
+ * @brief One LUT register holds the expected bytes
+ *
+ * @param step
+ * @param reg LUT command register
+ * @param expect bytes
+ * @param size bytes
+ */
+static void lutcheck_lut(const char* step, uint8_t reg, const uint8_t* expect, size_t size)
+{
+    size_t sent = 0;
+    const uint8_t* lut = uc8151_sim_lut(reg, &sent);
+    char what[64];
+
+    snprintf(what, sizeof(what), "LUT 0x%02x size %zu", reg, sent);
+    lutcheck(size == sent, step, what);
+    snprintf(what, sizeof(what), "LUT 0x%02x bytes", reg);
+    lutcheck(lut && 0 == memcmp(lut, expect, size), step, what);
+}
+
+/**
+ * @brief Register waveform loaded with each LUT sent once
+ *
+ * @param step
+ * @param expect waveform
+ * @param stats bus traffic of the update
+ */
+static void lutcheck_waveform(const char* step, const lutcheck_lut_t* expect, const uc8151_sim_stats_t* stats)
+{
+    lutcheck(LUTCHECK_PSR_REG == uc8151_sim_panel_setting(), step, "panel setting not register LUTs");
+    lutcheck_lut(step, UC8151_LUT_VCOM, expect->vcom, sizeof(expect->vcom));
+    lutcheck_lut(step, UC8151_LUT_WW, expect->white, sizeof(expect->white));
+    lutcheck_lut(step, UC8151_LUT_BW, expect->white, sizeof(expect->white));
+    lutcheck_lut(step, UC8151_LUT_WB, expect->black, sizeof(expect->black));
+    lutcheck_lut(step, UC8151_LUT_BB, expect->black, sizeof(expect->black));
+    for (uint8_t reg = UC8151_LUT_VCOM; reg <= UC8151_LUT_BB; reg++) {
+        lutcheck(1 == stats->command[reg], step, "LUT not sent once");
+    }
+}
+
+/**
+ * @brief No LUT sent
+ *
+ * @param step
+ * @param stats bus traffic of the update
+ */
+static void lutcheck_no_luts(const char* step, const uc8151_sim_stats_t* stats)
+{
+    for (uint8_t reg = UC8151_LUT_VCOM; reg <= UC8151_LUT_BB; reg++) {
+        lutcheck(0 == stats->command[reg], step, "LUT sent again");
+    }
+}
+
+/**
+ * @brief Refresh and read the bus traffic it caused
+ *
+ * @param stats
+ */
+static void lutcheck_refresh(uc8151_sim_stats_t* stats)
+{
+    uc8151_sim_stats_reset();
+    uc8151_refresh();
+    uc8151_sim_stats(stats);
+}
+
+/**
+ * @brief Panel shows black in the rectangles and white elsewhere
+ *
+ * @param step
+ * @param rects x1, y1, x2, y2 of each, ends excluded and y a multiple of 8
+ * @param count
+ */
+static void lutcheck_panel(const char* step, const uint16_t (*rects)[4], uint8_t count)
+{
+    const uint8_t* panel = uc8151_sim_panel();
+    bool ok = true;
+
+    for (uint16_t x = 0; ok && x < UC8151_WIDTH; x++) {
+        for (uint16_t y = 0; ok && y < LUTCHECK_LINE_SIZE; y++) {
+            uint8_t expect = 0xff;
+            for (uint8_t i = 0; i < count; i++) {
+                if (rects[i][0] <= x && rects[i][2] > x && rects[i][1] / 8 <= y && rects[i][3] / 8 > y) {
+                    expect = 0x00;
+                }
+            }
+            ok = expect == panel[x * LUTCHECK_LINE_SIZE + y];
+        }
+    }
+    lutcheck(ok, step, "panel image");
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Main
+ *
+ * @return int
+ */
+int main()
+{
+    static const uint16_t rects[][4] = { { 8, 8, 24, 24 }, { 200, 96, 240, 120 } };
+    uc8151_sim_stats_t stats;
+
+    uc8151_setup();
+    uc8151_init();
+    lutcheck(LUTCHECK_PSR_OTP == uc8151_sim_panel_setting(), "init", "panel setting not OTP");
+
+    // OTP full refresh sends no LUT
+    uc8151_clear();
+    lutcheck_refresh(&stats);
+    lutcheck(LUTCHECK_PSR_OTP == uc8151_sim_panel_setting(), "full", "panel setting not OTP");
+    lutcheck_no_luts("full", &stats);
+    lutcheck(1 == stats.refreshes, "full", "not one refresh");
+
+    // Fast refresh loads its LUTs once
+    uc8151_set_update(UC8151_UPDATE_FAST, 0);
+    uc8151_fill_rectangle(rects[0][0], rects[0][1], rects[0][2], rects[0][3], 0x00);
+    lutcheck_refresh(&stats);
+    lutcheck_waveform("fast", &lutcheck_fast, &stats);
+    lutcheck_panel("fast", rects, 1);
+
+    uc8151_fill_rectangle(rects[0][0], rects[0][1], rects[0][2], rects[0][3], 0xff);
+    lutcheck_refresh(&stats);
+    lutcheck_no_luts("fast again", &stats);
+    lutcheck_panel("fast again", rects, 0);
+
+    // Partial refresh loads its own LUTs, two windows in one refresh
+    uc8151_set_update(UC8151_UPDATE_PARTIAL, 0);
+    for (uint8_t i = 0; i < 2; i++) {
+        uc8151_fill_rectangle(rects[i][0], rects[i][1], rects[i][2], rects[i][3], 0x00);
+    }
+    lutcheck_refresh(&stats);
+    lutcheck_waveform("partial", &lutcheck_partial, &stats);
+    lutcheck(1 == stats.refreshes, "partial", "not one refresh");
+    lutcheck_panel("partial", rects, 2);
+
+    uc8151_fill_rectangle(rects[1][0], rects[1][1], rects[1][2], rects[1][3], 0xff);
+    lutcheck_refresh(&stats);
+    lutcheck_no_luts("partial again", &stats);
+    lutcheck_panel("partial again", rects, 1);
+
+    // Full refresh once the partial ones run over, back to the OTP waveform
+    uc8151_set_update(UC8151_UPDATE_PARTIAL, 4);
+    lutcheck_refresh(&stats);
+    lutcheck(LUTCHECK_PSR_OTP == uc8151_sim_panel_setting(), "full every", "panel setting not OTP");
+    lutcheck_no_luts("full every", &stats);
+    lutcheck(1 == stats.refreshes, "full every", "not one refresh");
+
+    // Partial LUTs reloaded after the full refresh and after a reset
+    uc8151_fill_rectangle(rects[1][0], rects[1][1], rects[1][2], rects[1][3], 0x00);
+    lutcheck_refresh(&stats);
+    lutcheck_waveform("partial after full", &lutcheck_partial, &stats);
+    lutcheck_panel("partial after full", rects, 2);
+
+    uc8151_set_update(UC8151_UPDATE_PARTIAL, 0);
+    uc8151_sleep();
+    uc8151_init();
+    uc8151_fill_rectangle(rects[0][0], rects[0][1], rects[0][2], rects[0][3], 0xff);
+    uc8151_fill_rectangle(rects[1][0], rects[1][1], rects[1][2], rects[1][3], 0xff);
+    lutcheck_refresh(&stats);
+    lutcheck_waveform("partial after reset", &lutcheck_partial, &stats);
+    lutcheck(1 == stats.refreshes, "partial after reset", "not one refresh");
+    lutcheck_panel("partial after reset", rects, 0);
+
+    printf("%s\n", lutcheck_failed ? "Failed" : "Passed");
+    return lutcheck_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
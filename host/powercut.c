@@ -0,0 +1,182 @@
+/**
+ * @file powercut.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Power loss consistency of the configuration store on simulated flash
+ *
+ * Saves a run of configurations from erased flash with power cut at every erase and program in turn, with a few
+ * different torn results each. After power is back the store must load the last configuration saved in full or the one
+ * being saved, never a mix or nothing once one was saved, and must then save and load the next one. Prints the erases
+ * per sector of the run without cuts and exits non-zero on the first failure.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "store.h"
+#include "store_hal.h"
+#include "store_sim.h"
+
+/* MACROS ****************************************/
+
+/**
+ * @brief Saves in a run, enough to go round the sectors twice
+ *
+ */
+#define POWERCUT_SAVES (80)
+
+/**
+ * @brief Torn results tried per operation
+ *
+ */
+#define POWERCUT_SEEDS (4)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Configuration sized like the device one
+ *
+ */
+typedef struct {
+    uint32_t value; ///< Save number
+    uint8_t fill[244]; ///< Filled from the save number
+} powercut_config_t;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Configuration of a save number
+ *
+ * @param config
+ * @param value
+ */
+static void powercut_make(powercut_config_t* config, uint32_t value)
+{
+    config->value = value;
+    for (size_t i = 0; i < sizeof(config->fill); i++) {
+        config->fill[i] = (uint8_t)(value * 31 + i);
+    }
+}
+
+/**
+ * @brief Save and write it out
+ *
+ * @param value
+ * @return true power was cut
+ * @return false
+ */
+static bool powercut_save(uint32_t value)
+{
+    powercut_config_t config;
+    powercut_make(&config, value);
+    store_save(&config, sizeof(config));
+    while (!store_step()) {
+    }
+    return store_sim_off();
+}
+
+/**
+ * @brief Load and check it is a whole configuration
+ *
+ * @param value loaded save number, 0 for none
+ * @return true loaded but not a whole configuration
+ * @return false
+ */
+static bool powercut_load(uint32_t* value)
+{
+    powercut_config_t config;
+    powercut_config_t expect;
+
+    store_init();
+    if (store_load(&config, sizeof(config))) {
+        *value = 0;
+        return false;
+    }
+    powercut_make(&expect, config.value);
+    *value = config.value;
+    return 0 != memcmp(&config, &expect, sizeof(config));
+}
+
+/**
+ * @brief Run of saves with power cut at an operation
+ *
+ * @param cut operation to cut at, 0 for none
+ * @param seed torn result
+ * @return true failed
+ * @return false
+ */
+static bool powercut_run(uint32_t cut, uint32_t seed)
+{
+    uint32_t saved = 0;
+    uint32_t value;
+
+    store_sim_reset();
+    store_sim_cut(cut, seed);
+    store_init();
+    for (uint32_t i = 1; i <= POWERCUT_SAVES; i++) {
+        if (powercut_save(i)) {
+            break;
+        }
+        saved = i;
+    }
+    store_sim_power_on();
+
+    if (powercut_load(&value)) {
+        printf("cut %u seed %u: save %u loaded torn\n", cut, seed, value);
+        return true;
+    }
+    if (value != saved && value != saved + 1) {
+        printf("cut %u seed %u: loaded save %u after save %u\n", cut, seed, value, saved);
+        return true;
+    }
+
+    // Carries on after the cut
+    uint32_t next = value + 1;
+    if (powercut_save(next) || powercut_load(&value) || next != value) {
+        printf("cut %u seed %u: save %u after the cut lost, loaded %u\n", cut, seed, next, value);
+        return true;
+    }
+    return false;
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Main
+ *
+ * @return int
+ */
+int main()
+{
+    // Run without cuts for the operation count and wear
+    if (powercut_run(0, 0)) {
+        return 1;
+    }
+    uint32_t ops = store_sim_ops();
+    printf("%u saves %u operations, erases per sector:", POWERCUT_SAVES, ops);
+    for (uint8_t sector = 0; sector < STORE_SECTORS; sector++) {
+        printf(" %u", store_sim_erases(sector));
+    }
+    printf("\n");
+
+    uint32_t runs = 0;
+    for (uint32_t cut = 1; cut <= ops; cut++) {
+        for (uint32_t seed = 0; seed < POWERCUT_SEEDS; seed++) {
+            if (powercut_run(cut, seed)) {
+                return 1;
+            }
+            runs++;
+        }
+    }
+    printf("%u power cuts consistent\n", runs);
+
+    return 0;
+}
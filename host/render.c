@@ -0,0 +1,158 @@
+/**
+ * @file render.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Renders the device screens on the simulated panel
+ *
+ * Draws the device screens, dumps each as PBM and prints the bus traffic per screen. Each screen is compared against
+ * its golden PBM in host/golden and its bytes on the wire against a budget, exits non-zero when one differs or is over.
+ * When a change of the screens is meant, copy the PBMs written over the golden ones.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bm.h"
+#include "screens.h"
+#include "uc8151c.h"
+#include "uc8151c_hal.h"
+#include "uc8151c_sim.h"
+
+/* MACROS ****************************************/
+
+// Bytes on the wire each screen may take
+#define RENDER_BUDGET_SETUP (4967)
+#define RENDER_BUDGET_RUN (3805)
+#define RENDER_BUDGET_MINUTE (593)
+#define RENDER_BUDGET_THERM (590)
+#define RENDER_BUDGET_MODE (140)
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Compare two files
+ *
+ * @param path
+ * @param golden
+ * @return true the files differ or cannot be read
+ * @return false
+ */
+static bool render_compare(const char* path, const char* golden)
+{
+    bool err = true;
+    FILE* f = fopen(path, "rb");
+    FILE* g = fopen(golden, "rb");
+    if (!f || !g) {
+        printf("Cannot read %s\n", f ? golden : path);
+    } else {
+        int c;
+        do {
+            c = fgetc(f);
+            err = c != fgetc(g);
+        } while (!err && EOF != c);
+    }
+    if (f) {
+        fclose(f);
+    }
+    if (g) {
+        fclose(g);
+    }
+    return err;
+}
+
+/**
+ * @brief Print the bus traffic since the last call, dump the panel and check it
+ *
+ * @param dir output directory
+ * @param name screen name
+ * @param budget bytes on the wire allowed
+ * @return true the panel differs from the golden PBM, or the screen is over budget or not one refresh
+ * @return false
+ */
+static bool render_report(const char* dir, const char* name, uint32_t budget)
+{
+    uc8151_sim_stats_t stats;
+    char path[256];
+    char golden[256];
+    bool err = false;
+
+    uc8151_sim_stats(&stats);
+    uc8151_sim_stats_reset();
+    printf("%-8s %6u bytes %6u data %4u commands %4u transfers %2u refreshes (window %u, dtm2 %u, lut %u)\n", name,
+        stats.bytes, stats.data, stats.commands, stats.transfers, stats.refreshes,
+        stats.command[UC8151_PARTIAL_WINDOW], stats.command[UC8151_DATA_START_TRANSMISSION_2], stats.command[UC8151_LUT_VCOM]);
+
+    if (budget < stats.bytes) {
+        printf("FAIL %s: %u bytes over the budget of %u\n", name, stats.bytes, budget);
+        err = true;
+    }
+
+    if (1 != stats.refreshes) {
+        printf("FAIL %s: not one refresh\n", name);
+        err = true;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s.pbm", dir, name);
+    snprintf(golden, sizeof(golden), "%s/%s.pbm", RENDER_GOLDEN_DIR, name);
+    if (uc8151_sim_dump_pbm(path) || render_compare(path, golden)) {
+        printf("FAIL %s: %s differs from %s\n", name, path, golden);
+        err = true;
+    }
+    return err;
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Main
+ *
+ * @param argc
+ * @param argv output directory, current directory by default
+ * @return int
+ */
+int main(int argc, char* argv[])
+{
+    const char* dir = argc > 1 ? argv[1] : ".";
+    bool err = false;
+
+    uc8151_setup();
+    uc8151_init();
+    uc8151_set_update(UC8151_UPDATE_PARTIAL, 10);
+    bm_init(uc8151_draw_bitmap);
+    uc8151_sim_stats_reset();
+
+    screens_setup();
+    uc8151_refresh();
+    err |= render_report(dir, "setup", RENDER_BUDGET_SETUP);
+
+    uc8151_init();
+    screens_run(12, 34);
+    uc8151_refresh();
+    uc8151_sleep();
+    err |= render_report(dir, "run", RENDER_BUDGET_RUN);
+
+    uc8151_init();
+    screens_run(12, 35);
+    uc8151_refresh();
+    uc8151_sleep();
+    err |= render_report(dir, "minute", RENDER_BUDGET_MINUTE);
+
+    uc8151_init();
+    screens_therm(21);
+    uc8151_refresh();
+    err |= render_report(dir, "therm", RENDER_BUDGET_THERM);
+
+    screens_mode(BM_ASSET_RADIO_ON);
+    uc8151_refresh();
+    err |= render_report(dir, "mode", RENDER_BUDGET_MODE);
+
+    printf("%s\n", err ? "Failed" : "Passed");
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
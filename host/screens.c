@@ -0,0 +1,74 @@
+/**
+ * @file screens.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Device screens drawn the way main.c does
+ *
+ * Shared by the host tools so they all measure the same layout. Only draws, refreshing is up to the caller. The screens
+ * go through the widgets so only what changed is redrawn, as on the device.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include "bm.h"
+#include "uc8151c.h"
+#include "ui.h"
+
+#include "screens.h"
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief ST_SETUP screen
+ *
+ */
+void screens_setup()
+{
+    uc8151_clear();
+    ui_init();
+    ui_text(UI_TITLE, "%s", SCREENS_NAME);
+    ui_qr(UI_QR, "WIFI:S:%s;T:WPA;;;", SCREENS_NAME);
+    ui_text(UI_TEMP, "Setup");
+}
+
+/**
+ * @brief ST_RUN minute update
+ *
+ * @param hour
+ * @param min
+ */
+void screens_run(uint8_t hour, uint8_t min)
+{
+    ui_text(UI_TITLE, "%s", SCREENS_NAME);
+    ui_text(UI_URL, "http://%s", SCREENS_ADDR);
+    ui_qr(UI_QR, "http://%s", SCREENS_ADDR);
+    ui_text(UI_TIME, "%02d:%02d", hour, min);
+    ui_text(UI_TEMP, "%.01fC", 21.5f);
+    ui_asset(UI_MODE, BM_ASSET_CLOCK);
+    ui_asset(UI_OUTPUT, BM_ASSET_LIGHTNING);
+}
+
+/**
+ * @brief ST_RUN thermostat button
+ *
+ * @param therm thermostat setting
+ */
+void screens_therm(int8_t therm)
+{
+    ui_text(UI_TEMP, "%dC", therm);
+}
+
+/**
+ * @brief ST_RUN mode button
+ *
+ * @param mode mode icon
+ */
+void screens_mode(bm_asset_t mode)
+{
+    ui_asset(UI_MODE, mode);
+}
@@ -0,0 +1,27 @@
+/**
+ * @file screens.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Refer to .c file
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __SCREENS_H__
+#define __SCREENS_H__
+
+#include <stdint.h>
+
+#include "bm.h"
+
+#define SCREENS_NAME "picoThing1234567"
+#define SCREENS_ADDR "192.168.1.100"
+
+void screens_setup();
+void screens_run(uint8_t hour, uint8_t min);
+void screens_therm(int8_t therm);
+void screens_mode(bm_asset_t mode);
+
+#endif /* __SCREENS_H__ */
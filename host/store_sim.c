@@ -0,0 +1,195 @@
+/**
+ * @file store_sim.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Simulated NOR flash behind the store flash abstraction
+ *
+ * Erasing sets bytes to 0xff and programming can only clear bits, as on the real flash. Power can be cut at a chosen
+ * operation, which is then left torn: an erase with a random part of the sector erased and a program with a random
+ * part of the bits cleared. Every operation after the cut fails until power is back.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "store_hal.h"
+#include "store_sim.h"
+
+/* LOCAL VARIABLES ****************************************/
+
+static uint8_t sim_flash[STORE_SECTORS * STORE_SECTOR_SIZE];
+
+static uint32_t sim_erases[STORE_SECTORS];
+
+/**
+ * @brief Operations done
+ *
+ */
+static uint32_t sim_ops = 0;
+
+/**
+ * @brief Operation torn by the cut, 0 for none
+ *
+ */
+static uint32_t sim_cut = 0;
+
+static bool sim_off = false;
+
+static uint32_t sim_seed = 0;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Count an operation and see if power goes with it
+ *
+ * @param torn set when this operation is cut short
+ * @return true power is off, nothing done
+ * @return false
+ */
+static bool sim_op(bool* torn)
+{
+    *torn = false;
+    if (sim_off) {
+        return true;
+    }
+    sim_ops++;
+    if (sim_cut && sim_cut == sim_ops) {
+        *torn = true;
+        sim_off = true;
+    }
+    return false;
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Erased flash with power on and no cut
+ *
+ */
+void store_sim_reset()
+{
+    memset(sim_flash, 0xff, sizeof(sim_flash));
+    memset(sim_erases, 0, sizeof(sim_erases));
+    sim_ops = 0;
+    sim_cut = 0;
+    sim_off = false;
+}
+
+/**
+ * @brief Cut power during a later operation
+ *
+ * @param ops operations from now, the last one is torn, 0 to never cut
+ * @param seed for what the torn operation leaves
+ */
+void store_sim_cut(uint32_t ops, uint32_t seed)
+{
+    sim_cut = ops ? sim_ops + ops : 0;
+    sim_seed = seed;
+}
+
+/**
+ * @brief Power back on, the flash keeps what was left
+ *
+ */
+void store_sim_power_on()
+{
+    sim_cut = 0;
+    sim_off = false;
+}
+
+/**
+ * @brief Power was cut
+ *
+ * @return true
+ * @return false
+ */
+bool store_sim_off()
+{
+    return sim_off;
+}
+
+/**
+ * @brief Erases and programs done
+ *
+ * @return uint32_t
+ */
+uint32_t store_sim_ops()
+{
+    return sim_ops;
+}
+
+/**
+ * @brief Erases of a sector
+ *
+ * @param sector
+ * @return uint32_t
+ */
+uint32_t store_sim_erases(uint8_t sector)
+{
+    return sector < STORE_SECTORS ? sim_erases[sector] : 0;
+}
+
+/**
+ * @brief Simulated flash
+ *
+ */
+const uint8_t* store_hal_flash()
+{
+    return sim_flash;
+}
+
+/**
+ * @brief Erase a sector, torn at the cut
+ *
+ */
+bool store_hal_erase(uint32_t offset)
+{
+    bool torn;
+    if (STORE_SECTORS * STORE_SECTOR_SIZE <= offset || offset % STORE_SECTOR_SIZE || sim_op(&torn)) {
+        return true;
+    }
+
+    sim_erases[offset / STORE_SECTOR_SIZE]++;
+    if (torn) {
+        srand(sim_seed);
+        for (uint32_t i = 0; i < STORE_SECTOR_SIZE; i++) {
+            if (rand() & 1) {
+                sim_flash[offset + i] = 0xff;
+            }
+        }
+    } else {
+        memset(&sim_flash[offset], 0xff, STORE_SECTOR_SIZE);
+    }
+    return torn;
+}
+
+/**
+ * @brief Program a page, torn at the cut
+ *
+ */
+bool store_hal_program(uint32_t offset, const uint8_t* data)
+{
+    bool torn;
+    if (STORE_SECTORS * STORE_SECTOR_SIZE <= offset || offset % STORE_PAGE_SIZE || sim_op(&torn)) {
+        return true;
+    }
+
+    if (torn) {
+        srand(sim_seed);
+        for (uint32_t i = 0; i < STORE_PAGE_SIZE; i++) {
+            sim_flash[offset + i] &= data[i] | (uint8_t)rand();
+        }
+    } else {
+        for (uint32_t i = 0; i < STORE_PAGE_SIZE; i++) {
+            sim_flash[offset + i] &= data[i];
+        }
+    }
+    return torn;
+}
@@ -0,0 +1,24 @@
+/**
+ * @file store_sim.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Refer to .c file
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+#ifndef __STORE_SIM_H__
+#define __STORE_SIM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void store_sim_reset();
+void store_sim_cut(uint32_t ops, uint32_t seed);
+void store_sim_power_on();
+bool store_sim_off();
+uint32_t store_sim_ops();
+uint32_t store_sim_erases(uint8_t sector);
+
+#endif /* __STORE_SIM_H__ */
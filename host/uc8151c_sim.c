@@ -0,0 +1,382 @@
+/**
+ * @file uc8151c_sim.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Simulated UC8151C panel behind the driver bus abstraction
+ *
+ * Decodes the command stream into display RAM and a panel image, counts the bus traffic and dumps the panel as PBM.
+ * Transfers complete immediately and the panel is never busy.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "uc8151c.h"
+#include "uc8151c_hal.h"
+#include "uc8151c_sim.h"
+
+/* MACROS ****************************************/
+
+#ifndef MIN
+#define MIN(a, b) ((b) > (a) ? (a) : (b))
+#endif
+
+#define SIM_LINE_SIZE (UC8151_HEIGHT / 8)
+#define SIM_LUT_SIZE (44)
+#define SIM_LUTS (UC8151_LUT_BB - UC8151_LUT_VCOM + 1)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Simulated controller state
+ *
+ */
+typedef struct {
+    uint8_t ram[UC8151_WIDTH * SIM_LINE_SIZE]; ///< Display RAM written by DTM2
+    uint8_t panel[UC8151_WIDTH * SIM_LINE_SIZE]; ///< Image shown after the last refresh
+    uint8_t lut[SIM_LUTS][SIM_LUT_SIZE]; ///< Register LUTs
+    uint8_t lut_size[SIM_LUTS]; ///< Bytes written to each LUT
+    uint8_t psr; ///< Panel setting
+    uint8_t command; ///< Command receiving data
+    uint16_t index; ///< Data byte of the command
+    uint8_t params[8]; ///< Window parameters
+    bool partial; ///< Partial mode
+    uint8_t y1; ///< Window first vertical channel byte
+    uint8_t y2; ///< Window last vertical channel byte
+    uint16_t x1; ///< Window first horizontal line
+    uint16_t x2; ///< Window last horizontal line
+    uint16_t x; ///< Data cursor line
+    uint8_t y; ///< Data cursor byte
+    bool armed; ///< BUSY release watched
+} uc8151_sim_t;
+
+/* LOCAL VARIABLES ****************************************/
+
+static uc8151_sim_t sim;
+
+static uc8151_sim_stats_t sim_stats;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Area written by DTM2 and refreshed
+ *
+ * @param x1 first line
+ * @param x2 last line
+ * @param y1 first byte
+ * @param y2 last byte
+ */
+static void sim_area(uint16_t* x1, uint16_t* x2, uint8_t* y1, uint8_t* y2)
+{
+    if (sim.partial) {
+        *x1 = sim.x1;
+        *x2 = MIN(sim.x2, UC8151_WIDTH - 1);
+        *y1 = sim.y1;
+        *y2 = MIN(sim.y2, SIM_LINE_SIZE - 1);
+    } else {
+        *x1 = 0;
+        *x2 = UC8151_WIDTH - 1;
+        *y1 = 0;
+        *y2 = SIM_LINE_SIZE - 1;
+    }
+}
+
+/**
+ * @brief Decode a data byte of the current command
+ *
+ * @param data byte
+ */
+static void sim_data(uint8_t data)
+{
+    uint16_t x1, x2;
+    uint8_t y1, y2;
+
+    switch (sim.command) {
+    case UC8151_PANEL_SETTING:
+        if (0 == sim.index) {
+            sim.psr = data;
+        }
+        break;
+    case UC8151_PARTIAL_WINDOW:
+        if (sim.index < 7) {
+            sim.params[sim.index] = data;
+        }
+        if (6 == sim.index) {
+            sim.y1 = sim.params[0] / 8;
+            sim.y2 = sim.params[1] / 8;
+            sim.x1 = ((sim.params[2] & 0x01) << 8) | sim.params[3];
+            sim.x2 = ((sim.params[4] & 0x01) << 8) | sim.params[5];
+        }
+        break;
+    case UC8151_DATA_START_TRANSMISSION_2:
+        sim_area(&x1, &x2, &y1, &y2);
+        if (sim.x <= x2) {
+            sim.ram[sim.x * SIM_LINE_SIZE + sim.y] = data;
+            if (++sim.y > y2) {
+                sim.y = y1;
+                sim.x++;
+            }
+        }
+        break;
+    default:
+        if (UC8151_LUT_VCOM <= sim.command && UC8151_LUT_BB >= sim.command && SIM_LUT_SIZE > sim.index) {
+            sim.lut[sim.command - UC8151_LUT_VCOM][sim.index] = data;
+            sim.lut_size[sim.command - UC8151_LUT_VCOM] = sim.index + 1;
+        }
+        break;
+    }
+    sim.index++;
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Panel image after the last refresh, in the hardware raster
+ *
+ * @return const uint8_t*
+ */
+const uint8_t* uc8151_sim_panel()
+{
+    return sim.panel;
+}
+
+/**
+ * @brief Display RAM, in the hardware raster
+ *
+ * @return const uint8_t*
+ */
+const uint8_t* uc8151_sim_ram()
+{
+    return sim.ram;
+}
+
+/**
+ * @brief Register LUT as last written
+ *
+ * @param reg LUT command register
+ * @param size bytes written
+ * @return const uint8_t* NULL for an invalid register
+ */
+const uint8_t* uc8151_sim_lut(uint8_t reg, size_t* size)
+{
+    if (UC8151_LUT_VCOM > reg || UC8151_LUT_BB < reg) {
+        return NULL;
+    }
+    if (size) {
+        *size = sim.lut_size[reg - UC8151_LUT_VCOM];
+    }
+    return sim.lut[reg - UC8151_LUT_VCOM];
+}
+
+/**
+ * @brief Last panel setting
+ *
+ * @return uint8_t
+ */
+uint8_t uc8151_sim_panel_setting()
+{
+    return sim.psr;
+}
+
+/**
+ * @brief Read the bus traffic counters
+ *
+ * @param stats counters
+ */
+void uc8151_sim_stats(uc8151_sim_stats_t* stats)
+{
+    *stats = sim_stats;
+}
+
+/**
+ * @brief Clear the bus traffic counters
+ *
+ */
+void uc8151_sim_stats_reset()
+{
+    memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+/**
+ * @brief Write the panel image as a landscape PBM
+ *
+ * @param path file to write
+ * @return true
+ * @return false
+ */
+bool uc8151_sim_dump_pbm(const char* path)
+{
+    bool err = true;
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        printf("Cannot write %s\n", path);
+    } else {
+        fprintf(f, "P4\n%d %d\n", UC8151_WIDTH, UC8151_HEIGHT);
+        for (uint16_t y = 0; y < UC8151_HEIGHT; y++) {
+            uint8_t row[(UC8151_WIDTH + 7) / 8] = { 0 };
+            for (uint16_t x = 0; x < UC8151_WIDTH; x++) {
+                // Panel bit set is white, PBM bit set is black
+                if (!(sim.panel[x * SIM_LINE_SIZE + y / 8] & (0b10000000 >> (y & 0b111)))) {
+                    row[x / 8] |= 0b10000000 >> (x & 0b111);
+                }
+            }
+            fwrite(row, 1, sizeof(row), f);
+        }
+        fclose(f);
+        err = false;
+    }
+    return err;
+}
+
+/**
+ * @brief Setup ports for UC8151C
+ *
+ */
+void uc8151_hal_setup()
+{
+    memset(&sim, 0, sizeof(sim));
+    memset(sim.panel, 0xff, sizeof(sim.panel));
+}
+
+/**
+ * @brief Reset the controller, display RAM and LUTs are lost
+ *
+ */
+void uc8151_hal_reset()
+{
+    memset(sim.ram, 0x00, sizeof(sim.ram));
+    memset(sim.lut, 0x00, sizeof(sim.lut));
+    memset(sim.lut_size, 0x00, sizeof(sim.lut_size));
+    sim.psr = 0;
+    sim.partial = false;
+}
+
+void uc8151_hal_select(bool en)
+{
+    (void)en;
+}
+
+/**
+ * @brief Decode a command
+ *
+ * @param command command register
+ */
+void uc8151_hal_command(uint8_t command)
+{
+    uint16_t x1, x2;
+    uint8_t y1, y2;
+
+    sim_stats.bytes++;
+    sim_stats.commands++;
+    sim_stats.command[command]++;
+    sim.command = command;
+    sim.index = 0;
+
+    switch (command) {
+    case UC8151_PARTIAL_IN:
+        sim.partial = true;
+        break;
+    case UC8151_PARTIAL_OUT:
+        sim.partial = false;
+        break;
+    case UC8151_DATA_START_TRANSMISSION_2:
+        sim_area(&x1, &x2, &y1, &y2);
+        sim.x = x1;
+        sim.y = y1;
+        break;
+    case UC8151_DISPLAY_REFRESH:
+        sim_stats.refreshes++;
+        sim_area(&x1, &x2, &y1, &y2);
+        for (uint16_t x = x1; x <= x2; x++) {
+            memcpy(&sim.panel[x * SIM_LINE_SIZE + y1], &sim.ram[x * SIM_LINE_SIZE + y1], y2 - y1 + 1);
+        }
+        break;
+    }
+
+    if (sim.armed && (UC8151_DISPLAY_REFRESH == command || UC8151_POWER_ON == command || UC8151_POWER_OFF == command)) {
+        // Done straight away
+        sim.armed = false;
+        uc8151_busy_released();
+    }
+}
+
+/**
+ * @brief Decode a data transfer, completes immediately
+ *
+ * @param data source
+ * @param size bytes to send
+ * @param repeat send the first byte size times
+ */
+void uc8151_hal_stream(const uint8_t* data, uint16_t size, bool repeat)
+{
+    sim_stats.transfers++;
+    sim_stats.bytes += size;
+    sim_stats.data += size;
+    for (uint16_t i = 0; i < size; i++) {
+        sim_data(repeat ? data[0] : data[i]);
+    }
+    uc8151_stream_done();
+}
+
+void uc8151_hal_stream_end()
+{
+}
+
+void uc8151_hal_park()
+{
+}
+
+void uc8151_hal_abort()
+{
+    sim.armed = false;
+}
+
+bool uc8151_hal_busy()
+{
+    return false;
+}
+
+void uc8151_hal_busy_arm(bool en)
+{
+    sim.armed = en;
+}
+
+void uc8151_hal_alarm(uint32_t ms)
+{
+    (void)ms;
+}
+
+void uc8151_hal_alarm_cancel()
+{
+}
+
+uint32_t uc8151_hal_lock()
+{
+    return 0;
+}
+
+void uc8151_hal_unlock(uint32_t state)
+{
+    (void)state;
+}
+
+uint32_t uc8151_hal_millis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void uc8151_hal_sleep_ms(uint32_t ms)
+{
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000 };
+    nanosleep(&ts, NULL);
+}
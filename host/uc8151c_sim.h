@@ -0,0 +1,39 @@
+/**
+ * @file uc8151c_sim.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Refer to .c file
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+#ifndef __UC8151C_SIM_H__
+#define __UC8151C_SIM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Bus traffic counters
+ *
+ */
+typedef struct {
+    uint32_t bytes; ///< Command and data bytes on the wire
+    uint32_t data; ///< Data bytes
+    uint32_t commands; ///< Commands sent
+    uint32_t transfers; ///< Data transfers started
+    uint32_t refreshes; ///< Display refreshes
+    uint32_t command[256]; ///< Commands sent by register
+} uc8151_sim_stats_t;
+
+const uint8_t* uc8151_sim_panel();
+const uint8_t* uc8151_sim_ram();
+const uint8_t* uc8151_sim_lut(uint8_t reg, size_t* size);
+uint8_t uc8151_sim_panel_setting();
+void uc8151_sim_stats(uc8151_sim_stats_t* stats);
+void uc8151_sim_stats_reset();
+bool uc8151_sim_dump_pbm(const char* path);
+
+#endif /* __UC8151C_SIM_H__ */
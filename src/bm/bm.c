@@ -3,7 +3,8 @@
  * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
  * @brief Simple bitmap handling library
  *
- * Draws BMP fsdata files, XBM raw bitmaps, prints text from fronts in BMP and XBM and draws QR codes from text
+ * Draws built in assets, 1, 4 and 8 bit BMP fsdata files, XBM raw bitmaps, prints text from built in variable width
+ * fonts and fronts in BMP and XBM and draws QR codes from text
  *
  * @version 0.1
  * @date 2024-03-05
@@ -19,18 +20,41 @@
 #include <string.h>
 
 #include "lwip/apps/fs.h"
-#include "pico/stdlib.h"
 
 #include "bm.h"
 #include "qrcodegen.h"
 
 /* MACROS ****************************************/
 
-#define BM_HTTP_HEADER_SIZE (100)
 #define BM_TEXT_SIZE (80)
-#define BM_QR_SIZE (2048)
+#define BMP_TYPE (0x4d42)
+#define BMP_INFO_HEADER_SIZE (40)
+#define BMP_THRESHOLD (128)
+
+/**
+ * @brief Text composed per draw callback, about a display width of 32 pixel high text
+ *
+ */
+#define BM_STRIP_SIZE (1280)
 #define BM_QR_VERSION_MIN (qrcodegen_VERSION_MIN)
 #define BM_QR_VERSION_MAX (11)
+#define BM_QR_SCALE (2)
+#define BM_QR_SCALE_MAX (8)
+
+/**
+ * @brief Buffers sized for the largest version we encode, not qrcodegen_VERSION_MAX
+ *
+ */
+#define BM_QR_BUFFER_LEN (qrcodegen_BUFFER_LEN_FOR_VERSION(BM_QR_VERSION_MAX))
+#define BM_QR_MODULES_MAX (BM_QR_VERSION_MAX * 4 + 17)
+#define BM_QR_SIDE_MAX ((BM_QR_MODULES_MAX * BM_QR_SCALE + 7) & 0xfff8)
+#define BM_QR_SIZE (BM_QR_SIDE_MAX * BM_QR_SIDE_MAX / 8)
+
+_Static_assert(BM_QR_BUFFER_LEN <= BM_QR_SIZE, "QR temporary buffer must fit in the QR bitmap");
+
+#ifndef MIN
+#define MIN(a, b) ((b) > (a) ? (a) : (b))
+#endif
 
 /* TYPES ****************************************/
 
@@ -57,6 +81,20 @@ typedef struct {
     uint32_t important_colors; ///< Important colors
 } __attribute__((packed)) bmp_header_t;
 
+/**
+ * @brief BMP pixel rows in fsdata
+ *
+ */
+typedef struct {
+    const uint8_t* top; ///< Top row of the image
+    int32_t stride; ///< Bytes from a row to the one below, negative for bottom-up files
+    const uint8_t* palette; ///< Colour table, BGRA
+    uint16_t colors; ///< Colour table entries
+    uint16_t width; ///< Width in pixels
+    uint16_t height; ///< Height in pixels
+    uint8_t bpp; ///< Bits per pixel, 1, 4 or 8
+} bmp_image_t;
+
 /* FUNCTION PROTOTYPES ****************************************/
 
 /* GLOBAL VARIABLES ****************************************/
@@ -69,8 +107,378 @@ typedef struct {
  */
 static bm_draw_cbk_t bm_draw_cbk = NULL;
 
+/**
+ * @brief Glyph run handed to the draw callback
+ *
+ */
+static uint8_t bm_strip[BM_STRIP_SIZE];
+
+/**
+ * @brief 4x4 ordered dither matrix
+ *
+ */
+static const uint8_t bmp_bayer[4][4] = {
+    { 0, 8, 2, 10 },
+    { 12, 4, 14, 6 },
+    { 3, 11, 1, 9 },
+    { 15, 7, 13, 5 },
+};
+
+/**
+ * @brief Each bit of a nibble doubled
+ *
+ */
+static const uint8_t bm_qr_scale2[16] = {
+    0x00, 0x03, 0x0c, 0x0f, 0x30, 0x33, 0x3c, 0x3f, 0xc0, 0xc3, 0xcc, 0xcf, 0xf0, 0xf3, 0xfc, 0xff
+};
+
+/**
+ * @brief Each bit of a nibble tripled
+ *
+ */
+static const uint16_t bm_qr_scale3[16] = {
+    0x000, 0x007, 0x038, 0x03f, 0x1c0, 0x1c7, 0x1f8, 0x1ff, 0xe00, 0xe07, 0xe38, 0xe3f, 0xfc0, 0xfc7, 0xff8, 0xfff
+};
+
+/**
+ * @brief QR code bitmap handed to the draw callback, kept for the next draw of the same text
+ *
+ * Also the qrcodegen temporary buffer while encoding, the bitmap is rewritten afterwards anyway.
+ *
+ */
+static uint8_t bm_qr_bm[BM_QR_SIZE];
+
+/**
+ * @brief Text, hash and scale of the QR code in bm_qr_bm
+ *
+ */
+static struct {
+    uint32_t hash; ///< FNV-1a hash of the text
+    uint8_t scale; ///< Pixels per module
+    uint16_t side; ///< Width and height of the bitmap, 0 when empty
+    char text[BM_TEXT_SIZE]; ///< Encoded text
+} bm_qr_cache = { 0 };
+
 /* LOCAL FUNCTIONS ****************************************/
 
+/**
+ * @brief Shift dark pixels into a column, writing each byte as it fills
+ *
+ * @param acc pending pixels, set is dark
+ * @param bits number of pending pixels
+ * @param out next column byte
+ * @param val pixels to add, set is dark
+ * @param n number of pixels to add, at most 24
+ */
+static inline void bm_qr_push(uint32_t* acc, uint8_t* bits, uint8_t** out, uint32_t val, uint8_t n)
+{
+    *acc = (*acc << n) | val;
+    *bits += n;
+    while (*bits >= 8) {
+        *bits -= 8;
+        // Bit set is white
+        *(*out)++ = ~(uint8_t)(*acc >> *bits);
+    }
+}
+
+/**
+ * @brief Shift a column of up to 8 modules into a column, scaled
+ *
+ * @param acc pending pixels, set is dark
+ * @param bits number of pending pixels
+ * @param out next column byte
+ * @param dark modules, MSB at the top and set is dark
+ * @param n number of modules
+ * @param scale pixels per module
+ */
+static inline void bm_qr_push_modules(uint32_t* acc, uint8_t* bits, uint8_t** out, uint8_t dark, uint8_t n, uint8_t scale)
+{
+    switch (scale) {
+    case 1:
+        bm_qr_push(acc, bits, out, dark >> (8 - n), n);
+        break;
+    case 2:
+        bm_qr_push(acc, bits, out, ((bm_qr_scale2[dark >> 4] << 8) | bm_qr_scale2[dark & 0xf]) >> (2 * (8 - n)), 2 * n);
+        break;
+    case 3:
+        bm_qr_push(acc, bits, out, ((bm_qr_scale3[dark >> 4] << 12) | bm_qr_scale3[dark & 0xf]) >> (3 * (8 - n)), 3 * n);
+        break;
+    default:
+        for (uint8_t i = 0; i < n; i++) {
+            bm_qr_push(acc, bits, out, (dark & (0b10000000 >> i)) ? (1 << scale) - 1 : 0, scale);
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Read up to 8 modules of a QR row from the qrcodegen buffer
+ *
+ * Modules are packed row after row from the second byte, LSB first.
+ *
+ * @param qr encoded QR code
+ * @param index module index, row * size + column
+ * @param n number of modules
+ * @return uint8_t first module in the LSB, set is dark
+ */
+static inline uint8_t bm_qr_row_bits(const uint8_t* qr, uint32_t index, uint8_t n)
+{
+    const uint8_t* data = &qr[1 + (index >> 3)];
+    uint16_t bits = data[0];
+    if ((index & 0b111) + n > 8) {
+        // Spans two bytes, only read the second when needed so the end of the buffer is not passed
+        bits |= data[1] << 8;
+    }
+    return (bits >> (index & 0b111)) & ((1 << n) - 1);
+}
+
+/**
+ * @brief Transpose a block of 8 rows of 8 modules into 8 columns
+ *
+ * Rows are in the bytes from the most significant, first module in the LSB. Columns come out in the bytes from the
+ * least significant, first row in the MSB.
+ *
+ * @param x
+ * @return uint64_t
+ */
+static inline uint64_t bm_qr_transpose(uint64_t x)
+{
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaull;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000cccc0000ccccull;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ull;
+    x ^= t ^ (t << 28);
+    return x;
+}
+
+/**
+ * @brief FNV-1a hash of a string
+ *
+ * @param str
+ * @return uint32_t
+ */
+static uint32_t bm_hash(const char* str)
+{
+    uint32_t hash = 2166136261u;
+    while (*str) {
+        hash = (hash ^ (uint8_t)*str++) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Glyph of a character, the first glyph for characters not in the font
+ *
+ * @param font
+ * @param c
+ * @return uint8_t glyph index
+ */
+static uint8_t bm_font_index(const bm_font_data_t* font, char c)
+{
+    uint8_t index = (uint8_t)c - font->first;
+    return index < font->count ? index : 0;
+}
+
+/**
+ * @brief Clear a run of pixels down the columns of a bitmap
+ *
+ * @param bm
+ * @param pos first pixel
+ * @param n number of pixels
+ */
+static void bm_clear_run(uint8_t* bm, uint32_t pos, uint32_t n)
+{
+    while (n) {
+        uint8_t bit = pos & 0b111;
+        uint8_t len = MIN(8u - bit, n);
+        bm[pos / 8] &= ~((uint8_t)(0xff00 >> len) >> bit);
+        pos += len;
+        n -= len;
+    }
+}
+
+/**
+ * @brief Decode a glyph into column-major bitmap
+ *
+ * @param font
+ * @param index glyph
+ * @param out advance width columns of the font height
+ */
+static void bm_font_glyph(const bm_font_data_t* font, uint8_t index, uint8_t* out)
+{
+    uint8_t line = font->height / 8;
+    uint16_t size = font->advance[index] * line;
+
+    if (!font->offset) {
+        // Packed columns, the glyph follows the ones before it
+        uint32_t start = 0;
+        for (uint8_t i = 0; i < index; i++) {
+            start += font->advance[i];
+        }
+        memcpy(out, &font->data[start * line], size);
+    } else {
+        // Nibble runs starting white, 15 continues the same colour
+        const uint8_t* data = &font->data[font->offset[index]];
+        const uint8_t* end = &font->data[font->offset[index + 1]];
+        uint32_t total = size * 8;
+        uint32_t pos = 0;
+        bool dark = false;
+
+        memset(out, 0xff, size);
+        for (; data < end && pos < total; data++) {
+            for (int8_t shift = 4; shift >= 0 && pos < total; shift -= 4) {
+                uint8_t nibble = (*data >> shift) & 0xf;
+                uint32_t run = MIN(nibble, total - pos);
+                if (dark) {
+                    bm_clear_run(out, pos, run);
+                }
+                pos += run;
+                if (nibble < 15) {
+                    dark = !dark;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Locate the pixel rows of a BMP fsdata file
+ *
+ * fsdata is linked into flash and stays mapped after fs_close() so the rows are read in place.
+ *
+ * @param name
+ * @param image
+ * @return true
+ * @return false
+ */
+static bool bmp_open(const char* name, bmp_image_t* image)
+{
+    bool err = true;
+    struct fs_file file;
+    if (ERR_OK != fs_open(&file, name)) {
+        printf("Can't open %s\n", name);
+    } else {
+        const uint8_t* data = (const uint8_t*)file.data;
+        uint32_t len = file.len;
+
+        // Skip the HTTP header makefsdata puts in front of the file
+        if (file.flags & FS_FILE_FLAGS_HEADER_INCLUDED) {
+            for (uint32_t i = 0; i + 4 <= len; i++) {
+                if (!memcmp(&data[i], "\r\n\r\n", 4)) {
+                    data += i + 4;
+                    len -= i + 4;
+                    break;
+                }
+            }
+        }
+
+        const bmp_header_t* header = (const bmp_header_t*)data;
+        if (len < sizeof(bmp_header_t) || BMP_TYPE != header->type) {
+            printf("Invalid bmp file\n");
+        } else if (1 != header->num_planes || 0 != header->compression || BMP_INFO_HEADER_SIZE > header->dib_header_size
+            || (1 != header->bits_per_pixel && 4 != header->bits_per_pixel && 8 != header->bits_per_pixel)) {
+            printf("Unsupported bmp format\n");
+        } else {
+            uint8_t bpp = header->bits_per_pixel;
+            uint32_t width = header->width_px > 0 ? header->width_px : 0;
+            uint32_t height = header->height_px < 0 ? 0u - (uint32_t)header->height_px : (uint32_t)header->height_px;
+            // Rows are padded to 4 bytes
+            uint32_t row = (width * bpp + 31) / 32 * 4;
+            uint32_t colors = header->num_colors ? header->num_colors : 1u << bpp;
+            uint32_t palette = 14 + header->dib_header_size;
+
+            if (!width || UINT16_MAX < width || !height || UINT16_MAX < height || (1u << bpp) < colors
+                || len < palette || (len - palette) / 4 < colors || len < header->offset
+                || (len - header->offset) / row < height) {
+                printf("Invalid bmp size\n");
+            } else {
+                image->palette = &data[palette];
+                image->colors = colors;
+                image->width = width;
+                image->height = height;
+                image->bpp = bpp;
+                if (header->height_px < 0) {
+                    image->top = &data[header->offset];
+                    image->stride = row;
+                } else {
+                    image->top = &data[header->offset + (height - 1) * row];
+                    image->stride = -(int32_t)row;
+                }
+                err = false;
+            }
+        }
+        fs_close(&file);
+    }
+    return err;
+}
+
+/**
+ * @brief Whether a BMP pixel is white
+ *
+ * @param image
+ * @param row pixels of the row
+ * @param x
+ * @param y
+ * @param convert
+ * @return true
+ * @return false
+ */
+static inline bool bmp_white(const bmp_image_t* image, const uint8_t* row, uint16_t x, uint16_t y, bm_convert_t convert)
+{
+    uint8_t index;
+    switch (image->bpp) {
+    case 1:
+        index = (row[x / 8] >> (7 - (x & 0b111))) & 0b1;
+        break;
+    case 4:
+        index = (row[x / 2] >> ((x & 0b1) ? 0 : 4)) & 0xf;
+        break;
+    default:
+        index = row[x];
+        break;
+    }
+
+    uint8_t luma = 0;
+    if (index < image->colors) {
+        const uint8_t* bgr = &image->palette[index * 4];
+        luma = (bgr[0] * 29 + bgr[1] * 150 + bgr[2] * 77) >> 8;
+    }
+
+    if (BM_CONVERT_DITHER == convert) {
+        return luma >= bmp_bayer[y & 0b11][x & 0b11] * 16 + 8;
+    }
+    return luma >= BMP_THRESHOLD;
+}
+
+/**
+ * @brief Decode columns of a BMP into the display column-major raster
+ *
+ * Each band of 8 rows is read a row at a time and the pixels set into the column bytes, rows below the image are white.
+ *
+ * @param image
+ * @param x first column
+ * @param n number of columns
+ * @param convert
+ * @param out n columns of the height rounded up to 8
+ */
+static void bmp_columns(const bmp_image_t* image, uint16_t x, uint16_t n, bm_convert_t convert, uint8_t* out)
+{
+    uint16_t line = (image->height + 7) / 8;
+    memset(out, 0xff, n * line);
+    for (uint16_t y = 0; y < image->height; y++) {
+        const uint8_t* row = image->top + (int32_t)y * image->stride;
+        uint8_t* col = &out[y / 8];
+        uint8_t mask = ~(0b10000000 >> (y & 0b111));
+        for (uint16_t i = 0; i < n; i++) {
+            if (!bmp_white(image, row, x + i, y, convert)) {
+                col[i * line] &= mask;
+            }
+        }
+    }
+}
+
 /* GLOBAL FUCNTIONS ****************************************/
 
 /**
@@ -120,6 +528,38 @@ bool bm_draw_pixel(uint8_t* bm, uint16_t width, uint16_t height, uint16_t x, uin
     return err;
 }
 
+/**
+ * @brief Draw a white rectangle
+ *
+ * @param x
+ * @param y
+ * @param width
+ * @param height multiple of 8
+ * @return true
+ * @return false
+ */
+bool bm_draw_blank(uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    bool err = true;
+    uint16_t line = height / 8;
+    if (!line || BM_STRIP_SIZE < line) {
+        printf("Invalid height\n");
+    } else if (!bm_draw_cbk) {
+        printf("Not initiliazed\n");
+    } else {
+        uint16_t run = BM_STRIP_SIZE / line;
+        memset(bm_strip, 0xff, MIN(width, run) * line);
+        while (width) {
+            uint16_t n = MIN(width, run);
+            bm_draw_cbk(bm_strip, n, height, x, y);
+            x += n;
+            width -= n;
+        }
+        err = false;
+    }
+    return err;
+}
+
 /**
  * @brief Draw text from bitmap
  *
@@ -134,7 +574,7 @@ bool bm_draw_pixel(uint8_t* bm, uint16_t width, uint16_t height, uint16_t x, uin
  */
 bool bm_draw_string(uint8_t* bm, uint8_t char_w, uint8_t char_h, uint16_t x, uint16_t y, char* str)
 {
-    uint8_t col = 0;
+    uint16_t col = 0;
     bool err = true;
 
     if (!bm) {
@@ -142,10 +582,25 @@ bool bm_draw_string(uint8_t* bm, uint8_t char_w, uint8_t char_h, uint16_t x, uin
     } else if (!bm_draw_cbk) {
         printf("Not initiliazed\n");
     } else {
+        // Glyphs are whole columns so a run of them is one wider bitmap
+        uint16_t glyph = char_w * char_h / 8;
+        uint16_t run = glyph ? BM_STRIP_SIZE / glyph : 0;
+
         // Iterate through the string until terminator flag
         while (str[col] != '\0') {
-            bm_draw_cbk(&bm[(str[col] - 32) * char_w * char_h / 8], char_w, char_h, (col * char_w) + x, y);
-            col++;
+            uint16_t n = 0;
+            if (!run) {
+                // Glyph larger than the strip, draw it from the font
+                bm_draw_cbk(&bm[(str[col] - 32) * glyph], char_w, char_h, (col * char_w) + x, y);
+                n = 1;
+            } else {
+                while (n < run && str[col + n] != '\0') {
+                    memcpy(&bm_strip[n * glyph], &bm[(str[col + n] - 32) * glyph], glyph);
+                    n++;
+                }
+                bm_draw_cbk(bm_strip, n * char_w, char_h, (col * char_w) + x, y);
+            }
+            col += n;
         }
         err = false;
     }
@@ -182,43 +637,47 @@ bool bm_printf(uint8_t* bm, uint16_t width, uint16_t height, uint16_t x, uint16_
 }
 
 /**
- * @brief Load BMP fsdata file into a bitmap
+ * @brief Draw a BMP fsdata file
+ *
+ * The rows are read straight from fsdata a band of 8 at a time and turned into display columns, so any width and
+ * height is drawn through the strip without a decoded copy of the image.
  *
  * @param name
- * @param width
- * @param height
- * @return uint8_t*
+ * @param x
+ * @param y
+ * @param convert how colours are reduced to black and white
+ * @return true
+ * @return false
  */
-uint8_t* bmp_read(const char* name, uint16_t* width, uint16_t* height)
+bool bmp_render(const char* name, uint16_t x, uint16_t y, bm_convert_t convert)
 {
-    struct fs_file file;
-    uint8_t* bm = NULL;
+    bool err = true;
+    bmp_image_t image;
     if (!name) {
         printf("Invalid bmp filename\n");
-    } else {
-        if (ERR_OK == fs_open(&file, name)) {
-            bmp_header_t* header = (bmp_header_t*)&file.data[BM_HTTP_HEADER_SIZE];
-            if (0x4d42 == header->type && file.len - BM_HTTP_HEADER_SIZE == header->size && 1 == header->bits_per_pixel) {
-                bm = (char*)&file.data[BM_HTTP_HEADER_SIZE + header->offset];
-                if (!bm) {
-                    printf("Invalid bmp file\n");
-                } else {
-                    if (width) {
-                        *width = header->height_px;
-                    }
-                    if (height) {
-                        *height = header->width_px;
-                    }
-                }
+    } else if (!bm_draw_cbk) {
+        printf("Not initiliazed\n");
+    } else if (!bmp_open(name, &image)) {
+        uint16_t line = (image.height + 7) / 8;
+        if (BM_STRIP_SIZE < line) {
+            printf("Invalid height\n");
+        } else {
+            uint16_t run = BM_STRIP_SIZE / line;
+            for (uint16_t col = 0; col < image.width; col += run) {
+                uint16_t n = MIN(run, image.width - col);
+                bmp_columns(&image, col, n, convert, bm_strip);
+                bm_draw_cbk(bm_strip, n, line * 8, x + col, y);
             }
+            err = false;
         }
     }
-
-    return bm;
+    return err;
 }
 
 /**
- * @brief Draw text from BMP fomnt
+ * @brief Draw text from BMP font
+ *
+ * The font is a BMP strip of the 95 printable characters from ' ', each the same width.
  *
  * @param name
  * @param x
@@ -231,21 +690,38 @@ uint8_t* bmp_read(const char* name, uint16_t* width, uint16_t* height)
 bool bmp_printf(const char* name, uint16_t x, uint16_t y, const char* fmt, ...)
 {
     bool err = true;
+    bmp_image_t image;
     if (!name || !fmt) {
         printf("Invalid bmp filename or format\n");
-    } else {
-        uint16_t width = 0;
-        uint16_t height = 0;
-        uint8_t* bm = bmp_read(name, &width, &height);
-        if (!bm) {
-            printf("Invalid bmp file\n");
+    } else if (!bm_draw_cbk) {
+        printf("Not initiliazed\n");
+    } else if (!bmp_open(name, &image)) {
+        uint16_t char_w = image.width / 95;
+        uint16_t line = (image.height + 7) / 8;
+        uint16_t run = (char_w && line) ? BM_STRIP_SIZE / (char_w * line) : 0;
+        if (!run) {
+            printf("Invalid bmp font\n");
         } else {
             char text[BM_TEXT_SIZE] = "";
             va_list args;
             va_start(args, fmt);
             vsnprintf(text, BM_TEXT_SIZE, fmt, args);
             va_end(args);
-            err = bm_draw_string(bm, width / 95, height, x, y, text);
+
+            // Glyphs are whole columns so a run of them is one wider bitmap
+            for (const char* str = text; *str;) {
+                uint16_t n = 0;
+                while (n < run && str[n]) {
+                    uint8_t index = (uint8_t)str[n] - ' ';
+                    bmp_columns(&image, (index < 95 ? index : 0) * char_w, char_w, BM_CONVERT_THRESHOLD,
+                        &bm_strip[n * char_w * line]);
+                    n++;
+                }
+                bm_draw_cbk(bm_strip, n * char_w, line * 8, x, y);
+                x += n * char_w;
+                str += n;
+            }
+            err = false;
         }
     }
     return err;
@@ -261,26 +737,207 @@ bool bmp_printf(const char* name, uint16_t x, uint16_t y, const char* fmt, ...)
  * @return false
  */
 bool bmp_draw(const char* name, uint16_t x, uint16_t y)
+{
+    return bmp_render(name, x, y, BM_CONVERT_THRESHOLD);
+}
+
+/**
+ * @brief Draw a built in asset
+ *
+ * @param asset handle
+ * @param x
+ * @param y
+ * @return true
+ * @return false
+ */
+bool bm_asset_draw(bm_asset_t asset, uint16_t x, uint16_t y)
 {
     bool err = true;
-    if (!name) {
-        printf("Invalid bmp filename\n");
+    if (BM_ASSET_MAX <= asset) {
+        printf("Invalid asset\n");
     } else if (!bm_draw_cbk) {
         printf("Not initiliazed\n");
     } else {
-        uint16_t width = 0;
-        uint16_t height = 0;
-        uint8_t* bm = bmp_read(name, &width, &height);
-        if (!bm) {
-            printf("Invalid bmp file\n");
-        } else {
-            bm_draw_cbk(bm, width, height, x, y);
-            err = false;
+        const bm_asset_data_t* data = &bm_assets[asset];
+        bm_draw_cbk((uint8_t*)data->data, data->width, data->height, x, y);
+        err = false;
+    }
+    return err;
+}
+
+/**
+ * @brief Width of text in a built in font
+ *
+ * @param font handle
+ * @param str
+ * @return uint16_t columns
+ */
+uint16_t bm_font_width(bm_font_t font, const char* str)
+{
+    uint16_t width = 0;
+    if (BM_FONT_MAX <= font || !str) {
+        printf("Invalid font or text\n");
+    } else {
+        const bm_font_data_t* data = &bm_fonts[font];
+        for (; *str != '\0'; str++) {
+            width += data->advance[bm_font_index(data, *str)];
+        }
+    }
+    return width;
+}
+
+/**
+ * @brief Draw text from a built in font
+ *
+ * Glyphs are decoded one after another into a strip which goes to the draw callback when full and at the end.
+ *
+ * @param font handle
+ * @param x
+ * @param y
+ * @param str
+ * @return true
+ * @return false
+ */
+bool bm_font_draw_string(bm_font_t font, uint16_t x, uint16_t y, const char* str)
+{
+    bool err = true;
+    if (BM_FONT_MAX <= font || !str) {
+        printf("Invalid font or text\n");
+    } else if (!bm_draw_cbk) {
+        printf("Not initiliazed\n");
+    } else {
+        const bm_font_data_t* data = &bm_fonts[font];
+        uint8_t line = data->height / 8;
+        uint16_t cols = 0;
+
+        err = false;
+        for (; !err && *str != '\0'; str++) {
+            uint8_t index = bm_font_index(data, *str);
+            uint8_t advance = data->advance[index];
+            if ((cols + advance) * line > BM_STRIP_SIZE) {
+                if (cols) {
+                    bm_draw_cbk(bm_strip, cols, data->height, x, y);
+                    x += cols;
+                    cols = 0;
+                }
+                if (advance * line > BM_STRIP_SIZE) {
+                    printf("Glyph too large\n");
+                    err = true;
+                    break;
+                }
+            }
+            bm_font_glyph(data, index, &bm_strip[cols * line]);
+            cols += advance;
+        }
+        if (cols) {
+            bm_draw_cbk(bm_strip, cols, data->height, x, y);
         }
     }
     return err;
 }
 
+/**
+ * @brief Draw text from a built in font
+ *
+ * @param font handle
+ * @param x
+ * @param y
+ * @param fmt
+ * @param ...
+ * @return true
+ * @return false
+ */
+bool bm_font_printf(bm_font_t font, uint16_t x, uint16_t y, const char* fmt, ...)
+{
+    bool err = true;
+    if (!fmt) {
+        printf("Invalid format\n");
+    } else {
+        char text[BM_TEXT_SIZE] = "";
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(text, BM_TEXT_SIZE, fmt, args);
+        va_end(args);
+        err = bm_font_draw_string(font, x, y, text);
+    }
+    return err;
+}
+
+/**
+ * @brief Rasterize an encoded QR code into a column-major bitmap
+ *
+ * The code is read from the qrcodegen buffer in blocks of 8 rows of 8 modules, a byte of each row at a time, and each
+ * block is transposed into 8 columns. Columns are scaled with a lookup table and shifted into whole bytes, then copied
+ * for the remaining pixel columns of the module. The code is centred on a white square rounded up to whole bytes.
+ *
+ * @param qr encoded QR code
+ * @param scale pixels per module
+ * @param quiet white modules around the code
+ * @param bm bitmap to write
+ * @param size size of bm in bytes
+ * @return uint16_t width and height of the bitmap, 0 on error
+ */
+uint16_t bm_qr_raster(const uint8_t* qr, uint8_t scale, uint8_t quiet, uint8_t* bm, size_t size)
+{
+    uint16_t side = 0;
+    if (!qr || !bm || !scale || BM_QR_SCALE_MAX < scale) {
+        printf("Invalid QR code, bitmap or scale\n");
+    } else {
+        uint16_t modules = qrcodegen_getSize(qr);
+        uint16_t new_side = ((modules + 2 * quiet) * scale + 7) & 0xfff8;
+        uint16_t line = new_side / 8;
+        if ((size_t)new_side * line > size) {
+            printf("QR bitmap too small\n");
+        } else {
+            uint16_t border = (new_side - modules * scale) / 2;
+            uint8_t* cols = &bm[border * line];
+
+            // White columns before and after the code
+            memset(bm, 0xff, border * line);
+            memset(&cols[modules * scale * line], 0xff, (new_side - border - modules * scale) * line);
+
+            for (uint16_t x = 0; x < modules; x += 8) {
+                uint8_t w = MIN(8, modules - x);
+                uint32_t acc[8] = { 0 };
+                uint8_t bits[8];
+                uint8_t* out[8];
+
+                for (uint8_t c = 0; c < w; c++) {
+                    uint8_t* col = &cols[(x + c) * scale * line];
+                    memset(col, 0xff, line);
+                    bits[c] = border & 0b111;
+                    out[c] = &col[border / 8];
+                }
+
+                for (uint16_t y = 0; y < modules; y += 8) {
+                    uint8_t n = MIN(8, modules - y);
+                    uint64_t block = 0;
+                    for (uint8_t i = 0; i < n; i++) {
+                        block |= (uint64_t)bm_qr_row_bits(qr, (uint32_t)(y + i) * modules + x, w) << (8 * (7 - i));
+                    }
+                    block = bm_qr_transpose(block);
+                    for (uint8_t c = 0; c < w; c++) {
+                        bm_qr_push_modules(&acc[c], &bits[c], &out[c], block >> (8 * c), n, scale);
+                    }
+                }
+
+                for (uint8_t c = 0; c < w; c++) {
+                    uint8_t* col = &cols[(x + c) * scale * line];
+                    if (bits[c]) {
+                        // Partial byte, the rest of it is white
+                        *out[c] = ~(uint8_t)(acc[c] << (8 - bits[c]));
+                    }
+                    for (uint8_t i = 1; i < scale; i++) {
+                        memcpy(&col[i * line], col, line);
+                    }
+                }
+            }
+            side = new_side;
+        }
+    }
+    return side;
+}
+
 /**
  * @brief Draw QR code from text
  *
@@ -304,27 +961,28 @@ uint16_t bm_qr_printf(uint16_t x, uint16_t y, const char* fmt, ...)
         vsnprintf(text, BM_TEXT_SIZE, fmt, args);
         va_end(args);
 
-        // Text data
-        uint8_t qr0[qrcodegen_BUFFER_LEN_MAX];
-        uint8_t tempBuffer[qrcodegen_BUFFER_LEN_MAX];
-        if (!qrcodegen_encodeText(text, tempBuffer, qr0, qrcodegen_Ecc_MEDIUM, BM_QR_VERSION_MIN, BM_QR_VERSION_MAX, qrcodegen_Mask_AUTO, true)) {
-            printf("QR code error\n");
+        uint32_t hash = bm_hash(text);
+        if (bm_qr_cache.side && hash == bm_qr_cache.hash && BM_QR_SCALE == bm_qr_cache.scale && 0 == strcmp(text, bm_qr_cache.text)) {
+            // Same text as last time, skip encoding
+            new_size = bm_qr_cache.side;
         } else {
-            char bm[BM_QR_SIZE];
-            uint16_t size = qrcodegen_getSize(qr0);
-            new_size = ((size * 2) & 0xfff8) + 8;
-            uint16_t border = new_size / 2 - size;
-            memset(bm, 0xff, new_size * new_size / 8);
-            for (uint16_t y = 0; y < size; y++) {
-                for (uint16_t x = 0; x < size; x++) {
-                    bool val = qrcodegen_getModule(qr0, x, y);
-                    bm_draw_pixel(bm, new_size, new_size, x * 2 + border, y * 2 + border, val);
-                    bm_draw_pixel(bm, new_size, new_size, x * 2 + border, y * 2 + 1 + border, val);
-                    bm_draw_pixel(bm, new_size, new_size, x * 2 + 1 + border, y * 2 + border, val);
-                    bm_draw_pixel(bm, new_size, new_size, x * 2 + 1 + border, y * 2 + 1 + border, val);
+            // Text data, the temporary buffer is the bitmap being replaced
+            uint8_t qr0[BM_QR_BUFFER_LEN];
+            bm_qr_cache.side = 0;
+            if (!qrcodegen_encodeText(text, bm_qr_bm, qr0, qrcodegen_Ecc_MEDIUM, BM_QR_VERSION_MIN, BM_QR_VERSION_MAX, qrcodegen_Mask_AUTO, true)) {
+                printf("QR code error\n");
+            } else {
+                new_size = bm_qr_raster(qr0, BM_QR_SCALE, 0, bm_qr_bm, sizeof(bm_qr_bm));
+                if (new_size) {
+                    bm_qr_cache.hash = hash;
+                    bm_qr_cache.scale = BM_QR_SCALE;
+                    bm_qr_cache.side = new_size;
+                    strcpy(bm_qr_cache.text, text);
                 }
             }
-            bm_draw_cbk(bm, new_size, new_size, x, y);
+        }
+        if (new_size) {
+            bm_draw_cbk(bm_qr_bm, new_size, new_size, x, y);
         }
     }
     return new_size;
@@ -12,15 +12,62 @@
 #ifndef __BM_H__
 #define __BM_H__
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bm_assets.h"
+
+/**
+ * @brief Asset pre-parsed at build time by tools/bmassets.pl
+ *
+ */
+typedef struct {
+    const uint8_t* data; ///< Pixels in the display column-major raster, set bit is white
+    uint16_t width; ///< Width in display pixels
+    uint16_t height; ///< Height in display pixels, multiple of 8
+} bm_asset_data_t;
+
+/**
+ * @brief Variable width font converted at build time by tools/bmassets.pl
+ *
+ */
+typedef struct {
+    const uint8_t* data; ///< Glyphs as nibble pixel runs, or packed columns when offset is NULL
+    const uint16_t* offset; ///< Start of each glyph in data and the end of the last, NULL when packed
+    const uint8_t* advance; ///< Width of each glyph in columns
+    uint8_t height; ///< Height in display pixels, multiple of 8
+    uint8_t first; ///< First character
+    uint8_t count; ///< Number of glyphs
+} bm_font_data_t;
+
+extern const bm_asset_data_t bm_assets[BM_ASSET_MAX];
+extern const bm_font_data_t bm_fonts[BM_FONT_MAX];
+
+/**
+ * @brief Reduction of BMP colours to black and white
+ *
+ */
+typedef enum {
+    BM_CONVERT_THRESHOLD, ///< White from half brightness
+    BM_CONVERT_DITHER, ///< 4x4 ordered dither
+} bm_convert_t;
+
 typedef void (*bm_draw_cbk_t)(uint8_t* data, uint16_t width, uint16_t height, uint16_t x, uint16_t y);
 
 bool bm_init(bm_draw_cbk_t cbk);
+bool bm_draw_blank(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
 bool bm_draw_pixel(uint8_t* bm, uint16_t width, uint16_t height, uint16_t x, uint16_t y, bool val);
 bool bm_draw_string(uint8_t* bm, uint8_t char_w, uint8_t char_h, uint16_t x, uint16_t y, char* str);
 bool bm_printf(uint8_t* bm, uint16_t width, uint16_t height, uint16_t x, uint16_t y, const char* fmt, ...);
-uint8_t* bmp_read(const char* name, uint16_t* width, uint16_t* height);
 bool bmp_printf(const char* name, uint16_t x, uint16_t y, const char* fmt, ...);
+bool bmp_render(const char* name, uint16_t x, uint16_t y, bm_convert_t convert);
 bool bmp_draw(const char* name, uint16_t x, uint16_t y);
+bool bm_asset_draw(bm_asset_t asset, uint16_t x, uint16_t y);
+uint16_t bm_font_width(bm_font_t font, const char* str);
+bool bm_font_draw_string(bm_font_t font, uint16_t x, uint16_t y, const char* str);
+bool bm_font_printf(bm_font_t font, uint16_t x, uint16_t y, const char* fmt, ...);
+uint16_t bm_qr_raster(const uint8_t* qr, uint8_t scale, uint8_t quiet, uint8_t* bm, size_t size);
 uint16_t bm_qr_printf(uint16_t x, uint16_t y, const char* fmt, ...);
 
 #endif /* __BM_H__ */
@@ -1,7 +1,7 @@
 /**
  * @file fsdata_file.c
  * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
- * @brief Adds the automatic redirect to home page in wifi access point mode
+ * @brief Adds the automatic redirect to home page in wifi access point mode and the replies to a settings post
  * @version 0.1
  * @date 2024-03-05
  *
@@ -15,16 +15,26 @@ static const unsigned char data_404_html[] = "/404.html\0HTTP/1.1 302 Found\r\nL
 
 static const unsigned char data_302_html[] = "/302.html\0HTTP/1.1 302 Found\r\nLocation: /\r\nServer: lwIP/pre-0.6 (http://www.sics.se/~adam/lwip/)\r\nContent-type: text/html\r\n\r\n";
 
+static const unsigned char data_204_html[] = "/204.html\0HTTP/1.0 204 No Content\r\nServer: lwIP/pre-0.6 (http://www.sics.se/~adam/lwip/)\r\nCache-Control: no-store\r\n\r\n";
+
+static const unsigned char data_501_html[] = "/501.html\0HTTP/1.0 501 Not Implemented\r\nServer: lwIP/pre-0.6 (http://www.sics.se/~adam/lwip/)\r\nAllow: GET, POST\r\nContent-Length: 0\r\n\r\n";
+
 const struct fsdata_file file_404_html[] = { { FS_ROOT, data_404_html, data_404_html + 10, sizeof(data_404_html) - 10, FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_HEADER_PERSISTENT } };
 
 const struct fsdata_file file_302_html[] = { { file_404_html, data_302_html, data_302_html + 10, sizeof(data_302_html) - 10, FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_HEADER_PERSISTENT } };
 
+// Without the terminator, a 204 has no body
+const struct fsdata_file file_204_html[] = { { file_302_html, data_204_html, data_204_html + 10, sizeof(data_204_html) - 11, FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_HEADER_PERSISTENT } };
+
+// Methods httpd does not take, PUT included
+const struct fsdata_file file_501_html[] = { { file_204_html, data_501_html, data_501_html + 10, sizeof(data_501_html) - 11, FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_HEADER_PERSISTENT } };
+
 #undef FS_ROOT
 
-#define FS_ROOT file_302_html
+#define FS_ROOT file_501_html
 
 #define NUMFILES FS_NUMFILES
 
 #undef FS_NUMFILES
 
-#define FS_NUMFILES (NUMFILES + 2)
+#define FS_NUMFILES (NUMFILES + 4)
@@ -0,0 +1,274 @@
+/**
+ * @file input.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Debounced buttons with long press and repeat
+ *
+ * The GPIO interrupt timestamps each edge with the pin level into a ring and posts a SCHED_EVT_GPIO to wake the main
+ * loop, so no edge is lost while the loop is busy. input_read() turns the edges into button events in the main loop.
+ * The first edge is taken at once and edges within the debounce time after it are bounce, the pin is read again once
+ * it is over in case it settled the other way. Holding a button gives a long press then repeats, timed with a
+ * scheduler timer that is only running while a button is down or settling.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+#include "input.h"
+#include "sched.h"
+
+/* MACROS ****************************************/
+
+/**
+ * @brief Queued edges, power of 2
+ *
+ */
+#define INPUT_QUEUE_SIZE (32)
+
+/**
+ * @brief Edges after an accepted edge that are bounce in us
+ *
+ */
+#define INPUT_DEBOUNCE_US (20000)
+
+/**
+ * @brief Hold time for a long press in us
+ *
+ */
+#define INPUT_LONG_US (600000)
+
+/**
+ * @brief Repeat interval while held after a long press in us
+ *
+ */
+#define INPUT_REPEAT_US (150000)
+
+#ifndef MIN
+#define MIN(a, b) ((b) > (a) ? (a) : (b))
+#endif
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Raw edge from the interrupt
+ *
+ */
+typedef struct {
+    uint32_t time; ///< Timestamp in us
+    uint8_t btn; ///< Button
+    bool down; ///< Pin level after the edge, pressed
+} input_edge_t;
+
+/**
+ * @brief Debounced button state
+ *
+ */
+typedef struct {
+    bool down; ///< Pressed
+    bool settle; ///< Edges were ignored as bounce, read the pin once the debounce time is over
+    bool held; ///< Long press sent
+    uint32_t edge; ///< Time of the last accepted edge in us
+    uint32_t hold; ///< Time of the next long press or repeat in us
+} input_state_t;
+
+/* LOCAL VARIABLES ****************************************/
+
+/**
+ * @brief Button pins, pulled up and LOW when pressed
+ *
+ */
+static const uint input_pins[INPUT_BTN_MAX] = {
+    [INPUT_BTN_A] = 12,
+    [INPUT_BTN_B] = 13,
+    [INPUT_BTN_C] = 14,
+};
+
+/**
+ * @brief Edge ring
+ *
+ */
+static input_edge_t input_queue[INPUT_QUEUE_SIZE];
+
+/**
+ * @brief Edges queued, only written by the interrupt
+ *
+ */
+static volatile uint32_t input_head = 0;
+
+/**
+ * @brief Edges read, only written by input_read()
+ *
+ */
+static volatile uint32_t input_tail = 0;
+
+/**
+ * @brief Button states
+ *
+ */
+static input_state_t input_state[INPUT_BTN_MAX] = { 0 };
+
+/**
+ * @brief Scheduler timer for debounce, long press and repeat
+ *
+ */
+static uint8_t input_timer = SCHED_TIMER_MAX;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief GPIO interrupt, queues the edge with its time
+ *
+ * @param gpio
+ * @param events
+ */
+static void input_gpio_cb(uint gpio, uint32_t events)
+{
+    uint32_t time = time_us_32();
+    for (uint8_t btn = 0; btn < INPUT_BTN_MAX; btn++) {
+        if (input_pins[btn] == gpio) {
+            if (INPUT_QUEUE_SIZE != input_head - input_tail) {
+                input_queue[input_head & (INPUT_QUEUE_SIZE - 1)] = (input_edge_t) { .time = time, .btn = btn, .down = !gpio_get(gpio) };
+                __dmb();
+                input_head = input_head + 1;
+            }
+            sched_post(SCHED_EVT_GPIO, gpio, events);
+        }
+    }
+}
+
+/**
+ * @brief Take a debounced level change
+ *
+ * @param btn
+ * @param down
+ * @param time
+ * @param evt
+ */
+static void input_accept(uint8_t btn, bool down, uint32_t time, input_evt_t* evt)
+{
+    input_state_t* state = &input_state[btn];
+    state->down = down;
+    state->edge = time;
+    state->settle = false;
+    if (down) {
+        state->held = false;
+        state->hold = time + INPUT_LONG_US;
+    }
+    *evt = (input_evt_t) { .btn = btn, .action = down ? INPUT_PRESS : INPUT_RELEASE, .time = time };
+}
+
+/**
+ * @brief Run the timer for the earliest settle, long press or repeat
+ *
+ * @param now
+ */
+static void input_schedule(uint32_t now)
+{
+    bool run = false;
+    uint32_t wait = UINT32_MAX;
+    for (uint8_t btn = 0; btn < INPUT_BTN_MAX; btn++) {
+        const input_state_t* state = &input_state[btn];
+        if (state->settle) {
+            int32_t left = (int32_t)(state->edge + INPUT_DEBOUNCE_US - now);
+            wait = MIN(wait, left > 0 ? (uint32_t)left : 0);
+            run = true;
+        }
+        if (state->down) {
+            int32_t left = (int32_t)(state->hold - now);
+            wait = MIN(wait, left > 0 ? (uint32_t)left : 0);
+            run = true;
+        }
+    }
+
+    if (run) {
+        sched_timer_start(input_timer, (wait + 999) / 1000, false);
+    } else {
+        sched_timer_stop(input_timer);
+    }
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Set up the button pins and their interrupt
+ *
+ * @param timer scheduler timer for debounce, long press and repeat
+ */
+void input_init(uint8_t timer)
+{
+    input_timer = timer;
+    for (uint8_t btn = 0; btn < INPUT_BTN_MAX; btn++) {
+        gpio_init(input_pins[btn]);
+        gpio_set_dir(input_pins[btn], GPIO_IN);
+        gpio_pull_up(input_pins[btn]);
+        gpio_set_irq_enabled_with_callback(input_pins[btn], GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &input_gpio_cb);
+    }
+}
+
+/**
+ * @brief Next button event
+ *
+ * Call on each SCHED_EVT_GPIO and expiry of the input timer until it returns true.
+ *
+ * @param evt
+ * @return true no more events
+ * @return false
+ */
+bool input_read(input_evt_t* evt)
+{
+    bool err = true;
+    if (!evt) {
+        printf("Invalid event\n");
+    } else {
+        // Edges in the order they happened
+        while (err && input_tail != input_head) {
+            __dmb();
+            input_edge_t edge = input_queue[input_tail & (INPUT_QUEUE_SIZE - 1)];
+            input_tail = input_tail + 1;
+
+            input_state_t* state = &input_state[edge.btn];
+            if (edge.time - state->edge < INPUT_DEBOUNCE_US) {
+                state->settle = true;
+            } else if (edge.down != state->down) {
+                input_accept(edge.btn, edge.down, edge.time, evt);
+                err = false;
+            }
+        }
+
+        // Then what the time brings
+        uint32_t now = time_us_32();
+        for (uint8_t btn = 0; err && btn < INPUT_BTN_MAX; btn++) {
+            input_state_t* state = &input_state[btn];
+            if (state->settle && now - state->edge >= INPUT_DEBOUNCE_US) {
+                state->settle = false;
+                bool down = !gpio_get(input_pins[btn]);
+                if (down != state->down) {
+                    input_accept(btn, down, now, evt);
+                    err = false;
+                }
+            } else if (state->down && (int32_t)(now - state->hold) >= 0) {
+                *evt = (input_evt_t) { .btn = btn, .action = state->held ? INPUT_REPEAT : INPUT_LONG, .time = now };
+                state->held = true;
+                state->hold += INPUT_REPEAT_US;
+                // Do not catch up repeats missed while busy
+                if ((int32_t)(now - state->hold) >= 0) {
+                    state->hold = now + INPUT_REPEAT_US;
+                }
+                err = false;
+            }
+        }
+
+        input_schedule(now);
+    }
+    return err;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file input.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Refer to .c file
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Buttons
+ *
+ */
+typedef enum {
+    INPUT_BTN_A,
+    INPUT_BTN_B,
+    INPUT_BTN_C,
+    INPUT_BTN_MAX
+} input_btn_t;
+
+/**
+ * @brief Button actions
+ *
+ */
+typedef enum {
+    INPUT_PRESS, ///< Pressed
+    INPUT_RELEASE, ///< Released
+    INPUT_LONG, ///< Held down for the long press time
+    INPUT_REPEAT, ///< Still held down, at the repeat rate after the long press
+} input_action_t;
+
+/**
+ * @brief Debounced button event
+ *
+ */
+typedef struct {
+    input_btn_t btn; ///< Button
+    input_action_t action; ///< Action
+    uint32_t time; ///< When it happened in us
+} input_evt_t;
+
+void input_init(uint8_t timer);
+bool input_read(input_evt_t* evt);
+
+#endif /* __INPUT_H__ */
@@ -0,0 +1,457 @@
+/**
+ * @file json.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Streaming parser of flat JSON objects
+ *
+ * The body of a request is parsed a byte at a time as each piece of it arrives, so it is never gathered in one buffer
+ * and a value may be split anywhere across the pieces. Only the state, the key and the value being read are kept.
+ * Members are passed on by key index as soon as their value ends, with strings unescaped and numbers checked against
+ * the JSON grammar but left as text. Objects or arrays as values, and anything not JSON, stop the parse with an error.
+ *
+ * Keys are looked up with a perfect hash: json_keys_init() finds a seed that gives every key a slot of its own, so a
+ * lookup is one hash and one compare whatever the number of keys.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "json.h"
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief FNV-1a hash of a key to a slot
+ *
+ * @param seed
+ * @param name
+ * @param len
+ * @return uint8_t
+ */
+static uint8_t json_hash(uint8_t seed, const char* name, size_t len)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    while (len--) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return (hash ^ (hash >> 16)) & (JSON_KEY_SLOTS - 1);
+}
+
+/**
+ * @brief JSON white space
+ *
+ * @param c
+ * @return true
+ * @return false
+ */
+static bool json_space(char c)
+{
+    return ' ' == c || '\t' == c || '\n' == c || '\r' == c;
+}
+
+/**
+ * @brief Decimal digit
+ *
+ * @param c
+ * @return true
+ * @return false
+ */
+static bool json_digit(char c)
+{
+    return '0' <= c && '9' >= c;
+}
+
+/**
+ * @brief Number text follows the JSON grammar
+ *
+ * @param text terminated
+ * @return true
+ * @return false
+ */
+static bool json_number(const char* text)
+{
+    if ('-' == *text) {
+        text++;
+    }
+    if ('0' == *text) {
+        text++;
+    } else if (!json_digit(*text)) {
+        return false;
+    } else {
+        while (json_digit(*text)) {
+            text++;
+        }
+    }
+    if ('.' == *text) {
+        if (!json_digit(*++text)) {
+            return false;
+        }
+        while (json_digit(*text)) {
+            text++;
+        }
+    }
+    if ('e' == *text || 'E' == *text) {
+        text++;
+        if ('+' == *text || '-' == *text) {
+            text++;
+        }
+        if (!json_digit(*text)) {
+            return false;
+        }
+        while (json_digit(*text)) {
+            text++;
+        }
+    }
+    return !*text;
+}
+
+/**
+ * @brief Stop on an error
+ *
+ * @param json
+ * @param err
+ */
+static void json_fail(json_t* json, const char* err)
+{
+    json->state = JSON_ERROR;
+    json->err = err;
+}
+
+/**
+ * @brief Add a byte to the key or value being read
+ *
+ * @param json
+ * @param c
+ */
+static void json_append(json_t* json, char c)
+{
+    if (json->in_key) {
+        // Too long for any key, read on as unknown
+        if (json->key_len < JSON_KEY_SIZE - 1) {
+            json->key[json->key_len++] = c;
+        } else {
+            json->key_len = JSON_KEY_SIZE;
+        }
+    } else if (json->value_len < JSON_VALUE_SIZE - 1) {
+        json->value[json->value_len++] = c;
+    } else {
+        json_fail(json, "value too long");
+    }
+}
+
+/**
+ * @brief Value ended, pass the member on when its key is known
+ *
+ * @param json
+ */
+static void json_member(json_t* json)
+{
+    json->value[json->value_len] = '\0';
+    int8_t key = json_key(json->keys, json->key, json->key_len);
+
+    json->state = JSON_NEXT;
+    if (JSON_NUMBER == json->type && !json_number(json->value)) {
+        json_fail(json, "invalid number");
+    } else if (0 <= key && json->cbk && json->cbk(json->arg, key, json->type, json->value, json->value_len)) {
+        json_fail(json, "invalid value");
+    }
+}
+
+/**
+ * @brief Literal ended, true, false or null
+ *
+ * @param json
+ */
+static void json_literal(json_t* json)
+{
+    json->value[json->value_len] = '\0';
+    if (0 == strcmp(json->value, "true")) {
+        json->type = JSON_TRUE;
+        json_member(json);
+    } else if (0 == strcmp(json->value, "false")) {
+        json->type = JSON_FALSE;
+        json_member(json);
+    } else if (0 == strcmp(json->value, "null")) {
+        json->type = JSON_NULL;
+        json_member(json);
+    } else {
+        json_fail(json, "invalid literal");
+    }
+}
+
+/**
+ * @brief Unicode escape ended, added as UTF-8
+ *
+ * @param json
+ */
+static void json_unicode(json_t* json)
+{
+    uint16_t code = json->code;
+    json->state = json->in_key ? JSON_KEY : JSON_STRING_VALUE;
+    if (0 == code || (0xd800 <= code && 0xdfff >= code)) {
+        // A NUL would cut the text short, surrogate pairs are sent as UTF-8 anyway
+        json_fail(json, "unsupported escape");
+    } else if (0x80 > code) {
+        json_append(json, code);
+    } else if (0x800 > code) {
+        json_append(json, 0xc0 | (code >> 6));
+        json_append(json, 0x80 | (code & 0x3f));
+    } else {
+        json_append(json, 0xe0 | (code >> 12));
+        json_append(json, 0x80 | ((code >> 6) & 0x3f));
+        json_append(json, 0x80 | (code & 0x3f));
+    }
+}
+
+/**
+ * @brief Parse a byte
+ *
+ * @param json
+ * @param c
+ */
+static void json_byte(json_t* json, char c)
+{
+    static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+
+    switch (json->state) {
+    case JSON_START:
+        if ('{' == c) {
+            json->state = JSON_FIRST;
+        } else if (!json_space(c)) {
+            json_fail(json, "expected an object");
+        }
+        break;
+    case JSON_FIRST:
+    case JSON_KEY_START:
+        if ('"' == c) {
+            json->state = JSON_KEY;
+            json->in_key = true;
+            json->key_len = 0;
+        } else if ('}' == c && JSON_FIRST == json->state) {
+            json->state = JSON_DONE;
+        } else if (!json_space(c)) {
+            json_fail(json, "expected a key");
+        }
+        break;
+    case JSON_KEY:
+    case JSON_STRING_VALUE:
+        if ('"' == c) {
+            if (json->in_key) {
+                json->state = JSON_COLON;
+            } else {
+                json_member(json);
+            }
+        } else if ('\\' == c) {
+            json->state = JSON_ESCAPE;
+        } else if (' ' > (unsigned char)c) {
+            json_fail(json, "control character in string");
+        } else {
+            json_append(json, c);
+        }
+        break;
+    case JSON_ESCAPE:
+        json->state = json->in_key ? JSON_KEY : JSON_STRING_VALUE;
+        if ('u' == c) {
+            json->state = JSON_UNICODE;
+            json->code = 0;
+            json->hex = 0;
+        } else {
+            const char* escape = NULL;
+            for (uint8_t i = 0; !escape && escapes[i]; i += 2) {
+                if (c == escapes[i]) {
+                    escape = &escapes[i + 1];
+                }
+            }
+            if (escape) {
+                json_append(json, *escape);
+            } else {
+                json_fail(json, "invalid escape");
+            }
+        }
+        break;
+    case JSON_UNICODE:
+        if (json_digit(c)) {
+            json->code = (json->code << 4) | (c - '0');
+        } else if ('a' <= (c | 0x20) && 'f' >= (c | 0x20)) {
+            json->code = (json->code << 4) | ((c | 0x20) - 'a' + 10);
+        } else {
+            json_fail(json, "invalid escape");
+            break;
+        }
+        if (4 == ++json->hex) {
+            json_unicode(json);
+        }
+        break;
+    case JSON_COLON:
+        if (':' == c) {
+            json->state = JSON_VALUE;
+        } else if (!json_space(c)) {
+            json_fail(json, "expected a colon");
+        }
+        break;
+    case JSON_VALUE:
+        json->in_key = false;
+        json->value_len = 0;
+        if ('"' == c) {
+            json->state = JSON_STRING_VALUE;
+            json->type = JSON_STRING;
+        } else if ('-' == c || json_digit(c)) {
+            json->state = JSON_NUMBER_VALUE;
+            json->type = JSON_NUMBER;
+            json_append(json, c);
+        } else if ('a' <= c && 'z' >= c) {
+            json->state = JSON_LITERAL;
+            json_append(json, c);
+        } else if ('{' == c || '[' == c) {
+            json_fail(json, "nested values not supported");
+        } else if (!json_space(c)) {
+            json_fail(json, "expected a value");
+        }
+        break;
+    case JSON_NUMBER_VALUE:
+        if (json_digit(c) || '-' == c || '+' == c || '.' == c || 'e' == c || 'E' == c) {
+            json_append(json, c);
+        } else {
+            // Ended by what comes after it
+            json_member(json);
+            json_byte(json, c);
+        }
+        break;
+    case JSON_LITERAL:
+        if ('a' <= c && 'z' >= c) {
+            json_append(json, c);
+        } else {
+            json_literal(json);
+            json_byte(json, c);
+        }
+        break;
+    case JSON_NEXT:
+        if (',' == c) {
+            json->state = JSON_KEY_START;
+        } else if ('}' == c) {
+            json->state = JSON_DONE;
+        } else if (!json_space(c)) {
+            json_fail(json, "expected a comma");
+        }
+        break;
+    case JSON_DONE:
+        if (!json_space(c)) {
+            json_fail(json, "data after the object");
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Find the seed of a perfect hash of the keys
+ *
+ * @param keys
+ * @param names key names, kept
+ * @param count keys
+ * @return true no seed gives every key a slot of its own
+ * @return false
+ */
+bool json_keys_init(json_keys_t* keys, const char* const* names, uint8_t count)
+{
+    bool err = true;
+    if (!keys || !names || JSON_KEY_SLOTS < count) {
+        printf("Invalid keys\n");
+    } else {
+        keys->names = names;
+        keys->count = count;
+        keys->seed = 0;
+        do {
+            memset(keys->slots, 0, sizeof(keys->slots));
+            err = false;
+            for (uint8_t i = 0; !err && i < count; i++) {
+                uint8_t* slot = &keys->slots[json_hash(keys->seed, names[i], strlen(names[i]))];
+                err = 0 != *slot || JSON_KEY_SIZE <= strlen(names[i]);
+                *slot = i + 1;
+            }
+        } while (err && 0 != ++keys->seed);
+        if (err) {
+            printf("No perfect hash of the keys\n");
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Look a key up
+ *
+ * @param keys
+ * @param name
+ * @param len
+ * @return int8_t key index, -1 when unknown
+ */
+int8_t json_key(const json_keys_t* keys, const char* name, size_t len)
+{
+    int8_t key = -1;
+    if (keys && JSON_KEY_SIZE > len) {
+        uint8_t slot = keys->slots[json_hash(keys->seed, name, len)];
+        if (slot && 0 == strncmp(keys->names[slot - 1], name, len) && '\0' == keys->names[slot - 1][len]) {
+            key = slot - 1;
+        }
+    }
+    return key;
+}
+
+/**
+ * @brief Start parsing an object
+ *
+ * @param json
+ * @param keys passed on to cbk, others are skipped
+ * @param cbk called per member of a known key
+ * @param arg
+ */
+void json_init(json_t* json, const json_keys_t* keys, json_member_cb cbk, void* arg)
+{
+    memset(json, 0, sizeof(*json));
+    json->keys = keys;
+    json->cbk = cbk;
+    json->arg = arg;
+}
+
+/**
+ * @brief Parse the next piece of the object
+ *
+ * @param json
+ * @param data
+ * @param len
+ * @return true stopped on an error, json->err says why
+ * @return false
+ */
+bool json_parse(json_t* json, const char* data, size_t len)
+{
+    for (size_t i = 0; JSON_ERROR != json->state && i < len; i++) {
+        json_byte(json, data[i]);
+    }
+    return JSON_ERROR == json->state;
+}
+
+/**
+ * @brief Parse ended
+ *
+ * @param json
+ * @return true not a whole object, json->err says why
+ * @return false
+ */
+bool json_end(json_t* json)
+{
+    if (JSON_DONE != json->state && JSON_ERROR != json->state) {
+        json_fail(json, "incomplete object");
+    }
+    return JSON_DONE != json->state;
+}
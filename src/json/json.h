@@ -0,0 +1,120 @@
+/**
+ * @file json.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Refer to .c file
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __JSON_H__
+#define __JSON_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Longest key looked up, longer keys are unknown
+ *
+ */
+#define JSON_KEY_SIZE (16)
+
+/**
+ * @brief Longest value text with its terminator, longer values are an error
+ *
+ */
+#define JSON_VALUE_SIZE (72)
+
+/**
+ * @brief Perfect hash slots, power of 2 and a few times the keys
+ *
+ */
+#define JSON_KEY_SLOTS (32)
+
+/**
+ * @brief Member value types
+ *
+ */
+typedef enum {
+    JSON_STRING, ///< Unescaped text
+    JSON_NUMBER, ///< Number text as sent
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL,
+} json_type_t;
+
+/**
+ * @brief Parser states
+ *
+ */
+typedef enum {
+    JSON_START, ///< Before the object
+    JSON_FIRST, ///< After {, first key or }
+    JSON_KEY_START, ///< After a comma, key
+    JSON_KEY, ///< In a key
+    JSON_COLON, ///< After a key
+    JSON_VALUE, ///< After the colon
+    JSON_STRING_VALUE, ///< In a string value
+    JSON_ESCAPE, ///< After a backslash
+    JSON_UNICODE, ///< In a unicode escape
+    JSON_NUMBER_VALUE, ///< In a number
+    JSON_LITERAL, ///< In true, false or null
+    JSON_NEXT, ///< After a value, comma or }
+    JSON_DONE, ///< After the object
+    JSON_ERROR, ///< Stopped on an error
+} json_state_t;
+
+/**
+ * @brief Key set looked up with a perfect hash, a key is its index in the names
+ *
+ */
+typedef struct {
+    const char* const* names; ///< Key names
+    uint8_t count; ///< Keys
+    uint8_t seed; ///< Hash seed that gives every key a slot of its own
+    uint8_t slots[JSON_KEY_SLOTS]; ///< Key + 1 in each slot, 0 for none
+} json_keys_t;
+
+/**
+ * @brief Member of a known key, called as soon as its value ends
+ *
+ * @param arg
+ * @param key index in the key names
+ * @param type
+ * @param value terminated text
+ * @param len value bytes
+ * @return true value is not valid for the key, stops the parse
+ * @return false
+ */
+typedef bool (*json_member_cb)(void* arg, uint8_t key, json_type_t type, const char* value, size_t len);
+
+/**
+ * @brief Streaming parser of one flat object
+ *
+ */
+typedef struct {
+    const json_keys_t* keys; ///< Keys passed on
+    json_member_cb cbk; ///< Called per member of a known key
+    void* arg; ///< Argument of cbk
+    json_state_t state; ///< Where it is
+    json_type_t type; ///< Value type
+    bool in_key; ///< String being read is the key
+    char key[JSON_KEY_SIZE]; ///< Key so far
+    uint8_t key_len; ///< Key bytes, JSON_KEY_SIZE when too long
+    char value[JSON_VALUE_SIZE]; ///< Value so far
+    uint8_t value_len; ///< Value bytes
+    uint16_t code; ///< Unicode escape so far
+    uint8_t hex; ///< Digits of it
+    const char* err; ///< Why it stopped, NULL for no error
+} json_t;
+
+bool json_keys_init(json_keys_t* keys, const char* const* names, uint8_t count);
+int8_t json_key(const json_keys_t* keys, const char* name, size_t len);
+void json_init(json_t* json, const json_keys_t* keys, json_member_cb cbk, void* arg);
+bool json_parse(json_t* json, const char* data, size_t len);
+bool json_end(json_t* json);
+
+#endif /* __JSON_H__ */
@@ -96,10 +96,25 @@
 #define LWIP_MDNS_RESPONDER         1
 
 #define LWIP_HTTPD                  1
-#define LWIP_HTTPD_SSI              1
-#define LWIP_HTTPD_CGI              1
-#define LWIP_HTTPD_SSI_INCLUDE_TAG  0
+#define LWIP_HTTPD_SSI              0
+#define LWIP_HTTPD_CGI              0
+#define LWIP_HTTPD_SUPPORT_POST     1
+#define LWIP_HTTPD_SUPPORT_EXTSTATUS 1
+#define LWIP_HTTPD_CUSTOM_FILES     1
+#define LWIP_HTTPD_DYNAMIC_FILE_READ 1
+#define LWIP_HTTPD_FS_ASYNC_READ    1
 #define HTTPD_FSDATA_FILE           "fsdata_file.c"
+// Custom files are rendered into buffers reused once closed, copy them rather than keep them for retransmission.
+// Files in flash opened through them are persistent and sent in place.
+#define HTTP_IS_DATA_VOLATILE(hs)   ((hs)->handle && (hs)->handle->is_custom_file \
+                                     && !((hs)->handle->flags & FS_FILE_FLAGS_HEADER_PERSISTENT) ? TCP_WRITE_FLAG_COPY : 0)
+
+// httpd does not pass on the request headers, they are read from the segments as they come in.
+struct tcp_pcb;
+struct tcp_hdr;
+struct pbuf;
+int http_request_hook(const struct tcp_pcb* pcb, const struct tcp_hdr* hdr, const struct pbuf* p);
+#define LWIP_HOOK_TCP_INPACKET_PCB(pcb, hdr, optlen, opt1len, opt2, p) http_request_hook(pcb, hdr, p)
 
 void sntp_set_system_time_us(unsigned long sec, unsigned long us);
 #define SNTP_SERVER_DNS             1
@@ -11,18 +11,26 @@
 
 /* INCLUDES ****************************************/
 
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
 #include <time.h>
 
 #include "hardware/adc.h"
 #include "hardware/flash.h"
 #include "hardware/sync.h"
 #include "hardware/watchdog.h"
+#include "lwip/apps/fs.h"
 #include "lwip/apps/httpd.h"
 #include "lwip/apps/mdns.h"
 #include "lwip/apps/mqtt.h"
 #include "lwip/apps/sntp.h"
 #include "lwip/dns.h"
+#include "lwip/prot/tcp.h"
+#include "lwip/sys.h"
+#include "lwip/tcp.h"
 #include "pico/aon_timer.h"
 #include "pico/binary_info.h"
 #include "pico/cyw43_arch.h"
@@ -31,9 +39,15 @@
 #include "bm.h"
 #include "dhserver.h"
 #include "dnserver.h"
-#include "font.xbm"
+#include "input.h"
+#include "json.h"
 #include "lwipopts.h"
+#include "power.h"
+#include "render.h"
+#include "sched.h"
+#include "store.h"
 #include "uc8151c.h"
+#include "ui.h"
 
 /* MACROS ****************************************/
 
@@ -57,15 +71,37 @@
 #define WATCHDOG_TIMEOUT (30000)
 
 /**
- * @brief Main loop poll interval in ms
+ * @brief Watchdog keep alive interval in ms
  *
  */
-#define POLL_INTERVAL (1000)
+#define WATCHDOG_KEEPALIVE (5000)
 
 /**
- * @brief We're going to erase and reprogram a region 256k from the start of flash.
+ * @brief Time Wi-Fi stays up after connecting in ms when built to sleep
  *
- * Once done, we can access this at XIP_BASE + 256k.
+ * Long enough to set the clock, publish and change settings from the web page.
+ */
+#define POWER_WIFI_TIME (5 * 60 * 1000)
+
+/**
+ * @brief Partial display updates between full refreshes to clear ghosting
+ *
+ */
+#define DISPLAY_FULL_EVERY (10)
+
+/**
+ * @brief Time the buttons are left alone before the display refreshes in ms
+ *
+ * A burst of presses or a held button redraws the widgets and sends them with a single refresh. Set in the build.
+ */
+#ifndef DISPLAY_REFRESH_DELAY
+#define DISPLAY_REFRESH_DELAY (500)
+#endif
+
+/**
+ * @brief Configuration saved before the store, a single page 256k from the start of flash.
+ *
+ * The store starts on the same sector so it is read only until the first save.
  */
 #define FLASH_TARGET_OFFSET (256 * 1024)
 
@@ -81,22 +117,69 @@
  */
 #define NTP_DELTA (2208988800)
 
-// button GPIO mappings
-#define BTNA (12)
-#define BTNB (13)
-#define BTNC (14)
+/**
+ * @brief Status document buffer bytes, room for the header and every field escaped
+ *
+ */
+#define HTTP_STATUS_SIZE (768)
+#define HTTP_STATUS_HEADER (128)
+
+/**
+ * @brief Status documents being sent at once
+ *
+ */
+#define HTTP_STATUS_BUFFERS (2)
+
+/**
+ * @brief Server-sent event streams open at once
+ *
+ */
+#define HTTP_SSE_CLIENTS (2)
 
-// GPIO event types
-#define LEVEL_LOW (0x1)
-#define LEVEL_HIGH (0x2)
-#define EDGE_FALL (0x4)
-#define EDGE_RISE (0x8)
+/**
+ * @brief Server-sent event bytes read at a time, room for the header or any event
+ *
+ */
+#define HTTP_SSE_SIZE (256)
+
+/**
+ * @brief Server-sent event keep alive in ms
+ *
+ * Sent when nothing else was, before httpd gives up on the connection after HTTPD_MAX_RETRIES polls without progress.
+ */
+#define HTTP_SSE_KEEPALIVE (3000)
+
+/**
+ * @brief Request header line bytes kept, longer lines are cut short
+ *
+ */
+#define HTTP_REQUEST_LINE (96)
+
+/**
+ * @brief Connections whose request headers are kept, as many as lwIP has TCP connections
+ *
+ */
+#define HTTP_REQUESTS (MEMP_NUM_TCP_PCB)
+
+/**
+ * @brief Largest settings document posted
+ *
+ */
+#define HTTP_API_SIZE (512)
+
+/**
+ * @brief Time a settings post holds the parser in ms, httpd does not say when a connection posting is lost
+ *
+ */
+#define HTTP_API_TIMEOUT (5000)
+#define HTTP_API_FIELD(field) { offsetof(config_t, data.field), sizeof(((config_t*)0)->data.field) }
+#define HTTP_API_KEY(key) (1u << (key))
 
 // helpers
+#ifndef MIN
+#define MIN(a, b) ((b) > (a) ? (a) : (b))
+#endif
 #define INIT_IP4(a, b, c, d) { PP_HTONL(LWIP_MAKEU32(a, b, c, d)) }
-#define TOUPPER(c) (((c >= 'a') && (c <= 'z')) ? (c - ('a' - 'A')) : (c))
-#define HEXNUMBER(c) ((((c) < '0') || ((c) > 'F') || (((c) > '9') && ((c) < 'A'))) ? 0 : ((c) >= 'A') ? ((c) - ('0' + 7)) \
-                                                                                                      : ((c) - '0'))
 
 /* TYPES ****************************************/
 
@@ -118,6 +201,20 @@ typedef enum {
     ST_MAX
 } states_t;
 
+/**
+ * @brief Scheduler timers
+ *
+ */
+typedef enum {
+    TIMER_KEEPALIVE = 0,
+    TIMER_MINUTE,
+    TIMER_WIFI,
+    TIMER_INPUT,
+    TIMER_REFRESH,
+    TIMER_STORE,
+    TIMER_MAX
+} timers_t;
+
 /**
  * @brief uUser modes
  *
@@ -129,26 +226,6 @@ typedef enum {
     MODE_MAX
 } modes_t;
 
-/**
- * @brief HTTP SSI tags
- *
- */
-typedef enum {
-    TAG_NAME = 0,
-    TAG_ADDR,
-    TAG_TIME,
-    TAG_MQTTADDR,
-    TAG_MQTTUSR,
-    TAG_SETUP,
-    TAG_MODE,
-    TAG_TEMP,
-    TAG_THERM,
-    TAG_TIMER1,
-    TAG_TIMER2,
-    TAG_OUT,
-    TAG_MAX
-} http_ssi_tags_t;
-
 /**
  * @brief MQTT subscribed topics
  *
@@ -194,15 +271,87 @@ typedef struct {
     mqtt_topics_t mqtt_topic; ///< Last MQTT received publish topic
     char mqtt_topic_switch_set[64];
     float temp; ///< Current temperature
-    uint32_t btna; ///< Button A state
-    uint32_t btnb; ///< Button B state
-    uint32_t btnc; ///< Button C state
     bool out; ///< Output is driven
+    bool wifi; ///< Wi-Fi powered
+    bool synced; ///< Clock set from SNTP or the web page
 } status_t;
 
-/* FUNCTION PROTOTYPES ****************************************/
+/**
+ * @brief Server-sent event stream, live status fields pushed as they change
+ *
+ */
+typedef struct {
+    struct fs_file* file; ///< httpd file, NULL when free
+    fs_wait_cb cbk; ///< httpd waiting for an event, NULL when not
+    void* arg; ///< Argument of cbk
+    bool header; ///< HTTP header sent
+    bool fresh; ///< No event sent yet, send every field
+    u32_t sent; ///< sys_now() of the last send
+    float temp; ///< Last temperature sent
+    bool out; ///< Last output sent
+    modes_t mode; ///< Last mode sent
+    char time[sizeof(((status_t*)0)->time)]; ///< Last time sent
+} http_sse_t;
+
+/**
+ * @brief Request headers httpd does not pass on, read from the segments of a connection
+ *
+ */
+typedef struct {
+    const struct tcp_pcb* pcb; ///< Connection, NULL for none
+    u32_t seen; ///< sys_now() of the last segment
+    bool closed; ///< FIN or RST seen, freed once the segment is through
+    bool request; ///< Request line read
+    bool get; ///< GET or HEAD request
+    bool done; ///< Blank line after the headers seen
+    bool gzip; ///< Accept-Encoding takes gzip
+    char etag[HTTP_REQUEST_LINE]; ///< If-None-Match, empty for none
+    char line[HTTP_REQUEST_LINE]; ///< Header line so far
+    uint8_t len; ///< Bytes in line
+} http_request_t;
 
-static const char* http_cgi_handler_basic(int iIndex, int iNumParams, char* pcParam[], char* pcValue[]);
+/**
+ * @brief Settings document keys
+ *
+ */
+typedef enum {
+    API_SSID = 0,
+    API_PASS,
+    API_TZ,
+    API_TIME,
+    API_MQTTADDR,
+    API_MQTTUSR,
+    API_MQTTPWD,
+    API_MODE,
+    API_THERM,
+    API_TIMER1,
+    API_TIMER2,
+    API_MAX
+} api_keys_t;
+
+/**
+ * @brief Settings post being parsed, applied once the whole document is good
+ *
+ */
+typedef struct {
+    void* connection; ///< httpd connection posting, NULL when free
+    u32_t start; ///< sys_now() when it started
+    json_t json; ///< Parser
+    config_t config; ///< Configuration with the members so far
+    time_t time; ///< Local time in seconds
+    uint16_t keys; ///< Keys given, a bit each
+} http_api_t;
+
+/**
+ * @brief Configuration field a settings key sets
+ *
+ */
+typedef struct {
+    uint16_t offset; ///< In config_t
+    uint16_t size; ///< Bytes, 0 for none
+} http_api_field_t;
+
+/* FUNCTION PROTOTYPES ****************************************/
 
 /* GLOBAL VARIABLES ****************************************/
 
@@ -248,10 +397,9 @@ static status_t status = {
     .mqtt_con = false,
     .mqtt_topic = TOPIC_MAX,
     .temp = 20.0,
-    .btna = 0,
-    .btnb = 0,
-    .btnc = 0,
     .out = false,
+    .wifi = false,
+    .synced = false,
 };
 
 /**
@@ -280,33 +428,38 @@ static const dhcp_config_t dhcp_config = {
 };
 
 /**
- * @brief HTTP SSI tags
- *
- * max length of the tags defaults to be 8 chars
- * LWIP_HTTPD_MAX_TAG_NAME_LEN
- */
-static const char* __not_in_flash("httpd") http_ssi_tags[] = {
-    [TAG_NAME] = "name",
-    [TAG_ADDR] = "addr",
-    [TAG_TIME] = "time",
-    [TAG_MQTTADDR] = "mqttaddr",
-    [TAG_MQTTUSR] = "mqttusr",
-    [TAG_SETUP] = "setup",
-    [TAG_MODE] = "mode",
-    [TAG_TEMP] = "temp",
-    [TAG_THERM] = "therm",
-    [TAG_TIMER1] = "timer1",
-    [TAG_TIMER2] = "timer2",
-    [TAG_OUT] = "out",
+ * @brief Settings document key names
+ *
+ */
+static const char* const http_api_names[API_MAX] = {
+    [API_SSID] = "ssid",
+    [API_PASS] = "pass",
+    [API_TZ] = "tz",
+    [API_TIME] = "time",
+    [API_MQTTADDR] = "mqttaddr",
+    [API_MQTTUSR] = "mqttusr",
+    [API_MQTTPWD] = "mqttpwd",
+    [API_MODE] = "mode",
+    [API_THERM] = "therm",
+    [API_TIMER1] = "timer1",
+    [API_TIMER2] = "timer2",
 };
 
 /**
- * @brief CGI routing
+ * @brief Configuration field of each settings key, the time is not kept
  *
- * Base filename (URL) of a CGI and the associated function which is to be called when that URL is requested.
  */
-static const tCGI http_cgi_handlers[] = {
-    { "/", http_cgi_handler_basic },
+static const http_api_field_t http_api_fields[API_MAX] = {
+    [API_SSID] = HTTP_API_FIELD(ssid),
+    [API_PASS] = HTTP_API_FIELD(pass),
+    [API_TZ] = HTTP_API_FIELD(tz),
+    [API_MQTTADDR] = HTTP_API_FIELD(mqttaddr),
+    [API_MQTTUSR] = HTTP_API_FIELD(mqttusr),
+    [API_MQTTPWD] = HTTP_API_FIELD(mqttpwd),
+    [API_MODE] = HTTP_API_FIELD(mode),
+    [API_THERM] = HTTP_API_FIELD(therm),
+    [API_TIMER1] = HTTP_API_FIELD(timer1),
+    [API_TIMER2] = HTTP_API_FIELD(timer2),
 };
 
 /**
@@ -323,19 +476,70 @@ static const char* __not_in_flash("mqtt") mqtt_topics[] = {
  */
 static mqtt_client_t* mqtt_client = NULL;
 
+/**
+ * @brief Status document buffers, one per connection until it is closed
+ *
+ */
+static char http_status_buffers[HTTP_STATUS_BUFFERS][HTTP_STATUS_SIZE];
+static bool http_status_used[HTTP_STATUS_BUFFERS] = { false };
+
+/**
+ * @brief Server-sent event streams
+ *
+ */
+static http_sse_t http_sse_clients[HTTP_SSE_CLIENTS] = { 0 };
+
+/**
+ * @brief Request headers of each connection
+ *
+ */
+static http_request_t http_requests[HTTP_REQUESTS] = { 0 };
+
+/**
+ * @brief Request headers of the connection whose segment is being passed to httpd, NULL for none
+ *
+ */
+static http_request_t* http_request = NULL;
+
+/**
+ * @brief fs_open_custom() is opening a file itself
+ *
+ */
+static bool http_fs_nested = false;
+
+/**
+ * @brief Settings document keys looked up by perfect hash
+ *
+ */
+static json_keys_t http_api_keys;
+
+/**
+ * @brief Settings post
+ *
+ */
+static http_api_t http_api = { 0 };
+
+/**
+ * @brief Status line and reason of the last settings post that failed, sent as /api/error.json
+ *
+ */
+static const char* http_api_status = "400 Bad Request";
+static const char* http_api_error = "";
+
 /* LOCAL FUNCTIONS ****************************************/
 
 /**
  * @brief Save config in flash
  *
+ * Written a page at a time on TIMER_STORE between events.
+ *
  * @param config configuration data
  */
 static void flash_config_save(config_t* config)
 {
-    uint32_t ints = save_and_disable_interrupts();
-    flash_range_erase(FLASH_TARGET_OFFSET, FLASH_SECTOR_SIZE);
-    flash_range_program(FLASH_TARGET_OFFSET, (const uint8_t*)config, FLASH_PAGE_SIZE);
-    restore_interrupts(ints);
+    if (!store_save(&config->data, sizeof(config->data))) {
+        sched_timer_start(TIMER_STORE, 0, false);
+    }
 }
 
 /**
@@ -345,206 +549,589 @@ static void flash_config_save(config_t* config)
  */
 static void flash_config_load(config_t* config)
 {
-    if (CONFIG_MAGIC == ((config_t*)flash_target_contents)->data.magic) {
+    static config_t stored;
+
+    store_init();
+    if (!store_load(&stored.data, sizeof(stored.data)) && CONFIG_MAGIC == stored.data.magic) {
+        memcpy(config, &stored, sizeof(config->data));
+        printf("loaded cofiguration\n");
+    } else if (CONFIG_MAGIC == ((config_t*)flash_target_contents)->data.magic) {
         memcpy(config, flash_target_contents, sizeof(config->data));
         printf("loaded cofiguration\n");
     }
 }
 
 /**
- * @brief Callback for GPIO button events
+ * @brief drive output pin
  *
- * @param gpio GPIO number
- * @param events event type
+ * @param en set output pin to high
  */
-static void gpio_cb(uint gpio, uint32_t events)
+static void out(bool en)
 {
-    if (BTNA == gpio) {
-        status.btna = events;
-    } else if (BTNB == gpio) {
-        status.btnb = events;
-    } else if (BTNC == gpio) {
-        status.btnc = events;
+    if (!status.wifi) {
+        // The on board LED is on the Wi-Fi chip, gone while it is powered down
+    } else if (en) {
+        cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);
+    } else {
+        cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 0);
     }
 }
 
 /**
- * @brief drive output pin
+ * @brief Append to the status document
  *
- * @param en set output pin to high
+ * @param pos
+ * @param end
+ * @param fmt
+ * @param ...
+ * @return char* new end of the text, at most end - 1
  */
-static void out(bool en)
+static char* http_status_printf(char* pos, const char* end, const char* fmt, ...)
 {
-    if (en) {
-        cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);
-    } else {
-        cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 0);
+    if (pos < end) {
+        va_list args;
+        va_start(args, fmt);
+        int printed = vsnprintf(pos, end - pos, fmt, args);
+        va_end(args);
+        pos += (0 > printed) ? 0 : MIN(printed, end - pos - 1);
     }
+    return pos;
 }
 
 /**
- * @brief URL decoder
+ * @brief Append a quoted JSON string to the status document
  *
- * @param text
+ * @param pos
+ * @param end
+ * @param text escaped, control characters are replaced with spaces
+ * @return char* new end of the text, at most end - 1
  */
-static void http_cgi_urldecode(char* text)
+static char* http_status_string(char* pos, const char* end, const char* text)
 {
-    char* ptr = text;
-    char c;
-    int val;
-
-    while ('\0' != (c = *ptr)) {
-        if ('+' == c) {
-            *text = ' ';
-        } else if ('%' == c) {
-            c = *(++ptr);
-            c = TOUPPER(c);
-            val = (HEXNUMBER(c) << 4);
-            c = *(++ptr);
-            c = TOUPPER(c);
-            val += HEXNUMBER(c);
-            *text = (char)val;
-        } else {
-            *text = *ptr;
+    // Room for an escape pair, the closing quote and the terminator
+    if (pos + 4 <= end) {
+        *pos++ = '"';
+        while (*text && pos + 4 <= end) {
+            char c = *text++;
+            if ('"' == c || '\\' == c) {
+                *pos++ = '\\';
+                *pos++ = c;
+            } else {
+                *pos++ = (' ' > (unsigned char)c) ? ' ' : c;
+            }
+        }
+        *pos++ = '"';
+        *pos = '\0';
+    }
+    return pos;
+}
+
+/**
+ * @brief Put the HTTP header in front of a document rendered after room for it
+ *
+ * @param body
+ * @param pos end of the body
+ * @param status status code and reason
+ * @param len response bytes
+ * @return const char* start of the response
+ */
+static const char* http_status_header(char* body, const char* pos, const char* status, int* len)
+{
+    char header[HTTP_STATUS_HEADER];
+    int size = snprintf(header, sizeof(header),
+        "HTTP/1.0 %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\nCache-Control: no-store\r\n\r\n", status,
+        (int)(pos - body));
+    memcpy(body - size, header, size);
+
+    *len = pos - body + size;
+    return body - size;
+}
+
+/**
+ * @brief Render the status document with its HTTP header in one pass
+ *
+ * The body is written after room for the header which then goes in front of it.
+ *
+ * @param buffer HTTP_STATUS_SIZE bytes
+ * @return const char* start of the response
+ * @return int* response bytes
+ */
+static const char* http_status_render(char* buffer, int* len)
+{
+    char* body = buffer + HTTP_STATUS_HEADER;
+    const char* end = buffer + HTTP_STATUS_SIZE;
+    char* pos = body;
+
+    pos = http_status_printf(pos, end, "{\"name\":");
+    pos = http_status_string(pos, end, status.name);
+    pos = http_status_printf(pos, end, ",\"addr\":");
+    pos = http_status_string(pos, end, status.addr);
+    pos = http_status_printf(pos, end, ",\"time\":");
+    pos = http_status_string(pos, end, status.time);
+    pos = http_status_printf(pos, end, ",\"mqttaddr\":");
+    pos = http_status_string(pos, end, config.data.mqttaddr);
+    pos = http_status_printf(pos, end, ",\"mqttusr\":");
+    pos = http_status_string(pos, end, config.data.mqttusr);
+    pos = http_status_printf(pos, end, ",\"setup\":%s,\"mode\":%d,\"temp\":%.01f,\"therm\":%d,\"timer1\":",
+        ST_RUN == status.state ? "false" : "true", config.data.mode, status.temp, config.data.therm);
+    pos = http_status_string(pos, end, config.data.timer1);
+    pos = http_status_printf(pos, end, ",\"timer2\":");
+    pos = http_status_string(pos, end, config.data.timer2);
+    pos = http_status_printf(pos, end, ",\"out\":%s}", status.out ? "true" : "false");
+
+    return http_status_header(body, pos, "200 OK", len);
+}
+
+/**
+ * @brief Render why the last settings post failed with its HTTP header
+ *
+ * @param buffer HTTP_STATUS_SIZE bytes
+ * @return const char* start of the response
+ * @return int* response bytes
+ */
+static const char* http_error_render(char* buffer, int* len)
+{
+    char* body = buffer + HTTP_STATUS_HEADER;
+    const char* end = buffer + HTTP_STATUS_SIZE;
+    char* pos = body;
+
+    pos = http_status_printf(pos, end, "{\"error\":");
+    pos = http_status_string(pos, end, http_api_error);
+    pos = http_status_printf(pos, end, "}");
+
+    return http_status_header(body, pos, http_api_status, len);
+}
+
+/**
+ * @brief Server-sent event stream of an httpd file
+ *
+ * @param file
+ * @return http_sse_t* NULL when not a stream
+ */
+static http_sse_t* http_sse_find(const struct fs_file* file)
+{
+    for (uint8_t i = 0; i < HTTP_SSE_CLIENTS; i++) {
+        if (file == http_sse_clients[i].file) {
+            return &http_sse_clients[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Render what the stream has to send next
+ *
+ * The HTTP header first, then an event with only the live fields changed since the last one, or a keep alive comment.
+ *
+ * @param sse
+ * @param buffer
+ * @param count buffer bytes
+ * @param send false to only check
+ * @return int bytes, 0 for nothing to send
+ */
+static int http_sse_render(http_sse_t* sse, char* buffer, int count, bool send)
+{
+    bool temp = sse->fresh || sse->temp != status.temp;
+    bool time = sse->fresh || 0 != strcmp(sse->time, status.time);
+    bool mode = sse->fresh || sse->mode != config.data.mode;
+    bool out = sse->fresh || sse->out != status.out;
+    bool keepalive = (u32_t)(sys_now() - sse->sent) >= HTTP_SSE_KEEPALIVE;
+
+    if (!send) {
+        return !sse->header || temp || time || mode || out || keepalive;
+    }
+
+    const char* end = buffer + count;
+    char* pos = buffer;
+    char sep = '{';
+
+    if (!sse->header) {
+        pos = http_status_printf(pos, end, "HTTP/1.0 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-store\r\n\r\n");
+        sse->header = true;
+    } else if (temp || time || mode || out) {
+        pos = http_status_printf(pos, end, "data: ");
+        if (temp) {
+            pos = http_status_printf(pos, end, "%c\"temp\":%.01f", sep, status.temp);
+            sse->temp = status.temp;
+            sep = ',';
+        }
+        if (time) {
+            pos = http_status_printf(pos, end, "%c\"time\":", sep);
+            pos = http_status_string(pos, end, status.time);
+            strcpy(sse->time, status.time);
+            sep = ',';
+        }
+        if (mode) {
+            pos = http_status_printf(pos, end, "%c\"mode\":%d", sep, config.data.mode);
+            sse->mode = config.data.mode;
+            sep = ',';
+        }
+        if (out) {
+            pos = http_status_printf(pos, end, "%c\"out\":%s", sep, status.out ? "true" : "false");
+            sse->out = status.out;
+        }
+        pos = http_status_printf(pos, end, "}\n\n");
+        sse->fresh = false;
+    } else if (keepalive) {
+        pos = http_status_printf(pos, end, ":\n\n");
+    }
+    return pos - buffer;
+}
+
+/**
+ * @brief Wake the server-sent event streams with something to send
+ *
+ * Called from the main loop after the status may have changed.
+ */
+static void http_sse_notify()
+{
+    cyw43_arch_lwip_begin();
+    for (uint8_t i = 0; i < HTTP_SSE_CLIENTS; i++) {
+        http_sse_t* sse = &http_sse_clients[i];
+        if (sse->file && sse->cbk && http_sse_render(sse, NULL, 0, false)) {
+            fs_wait_cb cbk = sse->cbk;
+            sse->cbk = NULL;
+            cbk(sse->arg);
+        }
+    }
+    cyw43_arch_lwip_end();
+}
+
+/**
+ * @brief Accept-Encoding value takes a content coding
+ *
+ * Each coding in the list may have a q value, q=0 refuses it. * takes any coding.
+ *
+ * @param value
+ * @param coding
+ * @return true
+ * @return false
+ */
+static bool http_request_accepts(const char* value, const char* coding)
+{
+    int8_t named = -1;
+    int8_t any = -1;
+    while (*value) {
+        value += strspn(value, " \t,");
+        size_t len = strcspn(value, " \t,;");
+        bool match = len == strlen(coding) && 0 == strncasecmp(value, coding, len);
+        bool star = 1 == len && '*' == *value;
+        value += len;
+        // Parameters, only q matters
+        size_t end = strcspn(value, ",");
+        const char* q = strstr(value, "q=");
+        bool accept = !q || q >= value + end || 0 != strtof(q + 2, NULL);
+        if (match) {
+            named = accept;
+        } else if (star) {
+            any = accept;
+        }
+        value += end;
+    }
+    // Named coding over *
+    return 0 < named || (0 > named && 0 < any);
+}
+
+/**
+ * @brief Request header line read
+ *
+ * @param line without the line end
+ */
+static void http_request_header(const char* line)
+{
+    static const char accept_encoding[] = "Accept-Encoding:";
+    static const char if_none_match[] = "If-None-Match:";
+
+    if (!http_request->request) {
+        http_request->request = true;
+        http_request->get = 0 == strncmp(line, "GET ", 4) || 0 == strncmp(line, "HEAD ", 5);
+    } else if (!*line) {
+        http_request->done = true;
+    } else if (0 == strncasecmp(line, accept_encoding, sizeof(accept_encoding) - 1)) {
+        http_request->gzip = http_request_accepts(line + sizeof(accept_encoding) - 1, "gzip");
+    } else if (0 == strncasecmp(line, if_none_match, sizeof(if_none_match) - 1)) {
+        line += sizeof(if_none_match) - 1;
+        strncpy(http_request->etag, line + strspn(line, " \t"), sizeof(http_request->etag) - 1);
+    }
+}
+
+/**
+ * @brief Request If-None-Match has the ETag of a file
+ *
+ * Tags are compared weakly as If-None-Match asks, so W/ is ignored, and * matches any file.
+ *
+ * @param file opened with its header
+ * @return true not modified
+ * @return false
+ */
+static bool http_request_cached(const struct fs_file* file)
+{
+    static const char etag[] = "ETag:";
+
+    bool cached = false;
+    const char* line = file->data;
+    const char* end = file->data + file->len;
+    // Header lines up to the blank line
+    while (!cached && http_request && *http_request->etag && line < end && '\r' != *line) {
+        const char* eol = memchr(line, '\n', end - line);
+        if (!eol) {
+            break;
+        } else if (0 == strncasecmp(line, etag, sizeof(etag) - 1)) {
+            char tag[HTTP_REQUEST_LINE];
+            line += sizeof(etag) - 1;
+            line += strspn(line, " \t");
+            size_t len = MIN((size_t)(eol - line), sizeof(tag) - 1);
+            memcpy(tag, line, len);
+            tag[len] = '\0';
+            tag[strcspn(tag, "\r")] = '\0';
+            cached = 0 == strcmp(http_request->etag, "*") || (*tag && strstr(http_request->etag, tag));
+        }
+        line = eol + 1;
+    }
+    return cached;
+}
+
+/**
+ * @brief Name is a gzip copy or a 304 Not Modified header the build made, only opened in place of its file
+ *
+ * @param name
+ * @return true
+ * @return false
+ */
+static bool http_fs_variant(const char* name)
+{
+    size_t len = strlen(name);
+    return (3 < len && 0 == strcmp(&name[len - 3], ".gz")) || (4 < len && 0 == strcmp(&name[len - 4], ".304"));
+}
+
+/**
+ * @brief Open a file of the build, for a GET the gzip copy when the request accepts gzip and only its 304 Not Modified
+ * header when the request already has it
+ *
+ * Files opened for other requests, such as the reply to a settings post, are sent as they are.
+ *
+ * @param file
+ * @param name
+ * @return true opened
+ * @return false not found
+ */
+static bool http_fs_open(struct fs_file* file, const char* name)
+{
+    char path[LWIP_HTTPD_MAX_REQUEST_URI_LEN + 8];
+    bool get = http_request && http_request->get;
+    bool found = false;
+
+    http_fs_nested = true;
+    if (get && http_request->gzip && sizeof(path) > (size_t)snprintf(path, sizeof(path), "%s.gz", name)) {
+        found = ERR_OK == fs_open(file, path);
+    }
+    if (!found && sizeof(path) > (size_t)snprintf(path, sizeof(path), "%s", name)) {
+        found = ERR_OK == fs_open(file, path);
+    }
+    if (found && get && http_request_cached(file) && sizeof(path) > strlen(path) + 4) {
+        struct fs_file header = { 0 };
+        strcat(path, ".304");
+        // Sent as it is when the build made no header for it
+        if (ERR_OK == fs_open(&header, path)) {
+            *file = header;
         }
-        ++ptr;
-        ++text;
     }
-    *text = '\0';
+    http_fs_nested = false;
+
+    return found;
 }
 
 /**
- * @brief HTTP SSI tag handler callback
+ * @brief Settings string member
  *
- * @param ssi id
- * @param pcinsert text insertion pointer
- * @param iInsertLen maximum inserted text length
- * @returns inserted text length
+ * @param dst
+ * @param size dst bytes
+ * @param type
+ * @param value
+ * @param len
+ * @return true not a string or too long
+ * @return false
  */
-static u16_t __time_critical_func(http_ssi_handler)(int iIndex, char* pcInsert, int iInsertLen)
+static bool http_api_string(char* dst, size_t size, json_type_t type, const char* value, size_t len)
 {
-    size_t printed;
-    switch (iIndex) {
-    case TAG_NAME:
-        printed = snprintf(pcInsert, iInsertLen, "%s", status.name);
+    bool err = JSON_STRING != type || size <= len;
+    if (!err) {
+        memcpy(dst, value, len + 1);
+    }
+    return err;
+}
+
+/**
+ * @brief Settings integer member
+ *
+ * @param number
+ * @param type
+ * @param value
+ * @param min
+ * @param max
+ * @return true not an integer or out of range
+ * @return false
+ */
+static bool http_api_integer(long long* number, json_type_t type, const char* value, long long min, long long max)
+{
+    char* end = NULL;
+    bool err = JSON_NUMBER != type;
+    if (!err) {
+        *number = strtoll(value, &end, 10);
+        err = '\0' != *end || min > *number || max < *number;
+    }
+    return err;
+}
+
+/**
+ * @brief Settings time of day member, HH:MM
+ *
+ * @param dst
+ * @param type
+ * @param value
+ * @param len
+ * @return true not a time of day
+ * @return false
+ */
+static bool http_api_clock(char* dst, json_type_t type, const char* value, size_t len)
+{
+    bool err = JSON_STRING != type || 5 != len || ':' != value[2];
+    for (uint8_t i = 0; !err && i < len; i++) {
+        err = 2 != i && ('0' > value[i] || '9' < value[i]);
+    }
+    if (!err && ('2' < value[0] || ('2' == value[0] && '3' < value[1]) || '5' < value[3])) {
+        err = true;
+    }
+    if (!err) {
+        memcpy(dst, value, len + 1);
+    }
+    return err;
+}
+
+/**
+ * @brief Settings document member, checked and set in the copy of the configuration
+ *
+ * @param arg http_api_t
+ * @param key api_keys_t
+ * @param type
+ * @param value
+ * @param len
+ * @return true not valid for the key
+ * @return false
+ */
+static bool http_api_member(void* arg, uint8_t key, json_type_t type, const char* value, size_t len)
+{
+    http_api_t* api = arg;
+    long long number = 0;
+    bool err = true;
+
+    switch (key) {
+    case API_SSID:
+        err = http_api_string(api->config.data.ssid, sizeof(api->config.data.ssid), type, value, len);
         break;
-    case TAG_ADDR:
-        printed = snprintf(pcInsert, iInsertLen, "%s", status.addr);
+    case API_PASS:
+        err = http_api_string(api->config.data.pass, sizeof(api->config.data.pass), type, value, len);
         break;
-    case TAG_TIME:
-        printed = snprintf(pcInsert, iInsertLen, "%s", status.time);
+    case API_TZ:
+        err = http_api_integer(&number, type, value, -24 * 60, 24 * 60);
+        api->config.data.tz = number;
         break;
-    case TAG_SETUP:
-        printed = snprintf(pcInsert, iInsertLen, ST_RUN == status.state ? "false" : "true");
+    case API_TIME:
+        err = http_api_integer(&number, type, value, 0, INT64_MAX);
+        api->time = number;
         break;
-    case TAG_MQTTADDR:
-        printed = snprintf(pcInsert, iInsertLen, "%s", config.data.mqttaddr);
+    case API_MQTTADDR:
+        err = http_api_string(api->config.data.mqttaddr, sizeof(api->config.data.mqttaddr), type, value, len);
         break;
-    case TAG_MQTTUSR:
-        printed = snprintf(pcInsert, iInsertLen, "%s", config.data.mqttusr);
+    case API_MQTTUSR:
+        err = http_api_string(api->config.data.mqttusr, sizeof(api->config.data.mqttusr), type, value, len);
         break;
-    case TAG_MODE:
-        printed = snprintf(pcInsert, iInsertLen, "%d", config.data.mode);
+    case API_MQTTPWD:
+        err = http_api_string(api->config.data.mqttpwd, sizeof(api->config.data.mqttpwd), type, value, len);
         break;
-    case TAG_TEMP:
-        printed = snprintf(pcInsert, iInsertLen, "%.01f", status.temp);
+    case API_MODE:
+        err = http_api_integer(&number, type, value, 0, MODE_MAX - 1);
+        api->config.data.mode = number;
         break;
-    case TAG_THERM:
-        printed = snprintf(pcInsert, iInsertLen, "%d", config.data.therm);
+    case API_THERM:
+        err = http_api_integer(&number, type, value, INT8_MIN, INT8_MAX);
+        api->config.data.therm = number;
         break;
-    case TAG_TIMER1:
-        printed = snprintf(pcInsert, iInsertLen, "%s", config.data.timer1);
+    case API_TIMER1:
+        err = http_api_clock(api->config.data.timer1, type, value, len);
         break;
-    case TAG_TIMER2:
-        printed = snprintf(pcInsert, iInsertLen, "%s", config.data.timer2);
+    case API_TIMER2:
+        err = http_api_clock(api->config.data.timer2, type, value, len);
         break;
-    case TAG_OUT:
-        printed = snprintf(pcInsert, iInsertLen, status.out ? "true" : "false");
+    default:
         break;
     }
-    return (u16_t)printed;
+    api->keys |= HTTP_API_KEY(key);
+
+    if (err) {
+        printf("HTTP settings %s invalid\n", http_api_names[key]);
+    }
+    return err;
 }
 
 /**
- * @brief HTTP CGI-handler triggered by a request
+ * @brief Apply a whole settings document
  *
- * @param iIndex http_cgi_handlers index
- * @param iNumParams number of parameters
- * @param pcParam parameters keys
- * @param pcValue parameters values
- * @return html file as http response
+ * Only the fields given are copied over, so a button pressed while it was posted is kept.
+ *
+ * @param api
  */
-static const char* http_cgi_handler_basic(int iIndex, int iNumParams, char* pcParam[], char* pcValue[])
+static void http_api_apply(const http_api_t* api)
 {
-    printf("cgi_handler_basic called with index %d and %d params\n", iIndex, iNumParams);
-
-    for (int i = 0; i < iNumParams; i++) {
-        http_cgi_urldecode(pcValue[i]);
-        if (0 == strcmp(pcParam[i], "ssid")) {
-            strncpy(config.data.ssid, pcParam[i], sizeof(config.data.ssid));
-            status.state = ST_RETRY;
-            status.save = true;
-        } else if (0 == strcmp(pcParam[i], "pass")) {
-            strncpy(config.data.pass, pcValue[i], sizeof(config.data.pass));
-            status.state = ST_RETRY;
+    for (uint8_t key = 0; key < API_MAX; key++) {
+        const http_api_field_t* field = &http_api_fields[key];
+        if ((api->keys & HTTP_API_KEY(key)) && field->size) {
+            memcpy((uint8_t*)&config + field->offset, (const uint8_t*)&api->config + field->offset, field->size);
             status.save = true;
-        } else if (0 == strcmp(pcParam[i], "tz")) {
-            config.data.tz = atoi(pcValue[i]);
-            status.save = true;
-        } else if (0 == strcmp(pcParam[i], "time")) {
-            time_t now = atoi(pcValue[i]);
-
-            struct timeval tv = {
-                .tv_sec = now
-            };
-            settimeofday(&tv, NULL);
-
-            struct timespec ts = {
-                .tv_sec = now
-            };
-            aon_timer_set_time(&ts);
-        } else if (0 == strcmp(pcParam[i], "mqttaddr")) {
-            strncpy(config.data.mqttaddr, pcValue[i], sizeof(config.data.mqttaddr));
-            // force reconnection
-            if (status.mqtt_con) {
-                mqtt_disconnect(mqtt_client);
-                status.mqtt_con = false;
-            }
-            status.save = true;
-        } else if (0 == strcmp(pcParam[i], "mqttusr")) {
-            strncpy(config.data.mqttusr, pcValue[i], sizeof(config.data.mqttusr));
-            // force reconnection
-            if (status.mqtt_con) {
-                mqtt_disconnect(mqtt_client);
-                status.mqtt_con = false;
-            }
-            status.save = true;
-        } else if (0 == strcmp(pcParam[i], "mqttpwd")) {
-            strncpy(config.data.mqttpwd, pcValue[i], sizeof(config.data.mqttpwd));
-            // force reconnection
-            if (status.mqtt_con) {
-                mqtt_disconnect(mqtt_client);
-                status.mqtt_con = false;
-            }
-            status.save = true;
-        } else if (0 == strcmp(pcParam[i], "mode")) {
-            uint8_t mode = atoi(pcValue[i]);
-            if (MODE_MAX > mode) {
-                config.data.mode = mode;
-                status.save = true;
-            }
-        } else if (0 == strcmp(pcParam[i], "therm")) {
-            config.data.therm = atoi(pcValue[i]);
-            status.save = true;
-        } else if (0 == strcmp(pcParam[i], "timer1")) {
-            strncpy(config.data.timer1, pcValue[i], sizeof(config.data.timer1));
-        } else if (0 == strcmp(pcParam[i], "timer2")) {
-            strncpy(config.data.timer2, pcValue[i], sizeof(config.data.timer2));
         }
     }
 
-    // Server redirect to clear get request
-    return "/302.html";
+    if (api->keys & HTTP_API_KEY(API_TIME)) {
+        struct timeval tv = {
+            .tv_sec = api->time
+        };
+        settimeofday(&tv, NULL);
+
+        struct timespec ts = {
+            .tv_sec = api->time
+        };
+        aon_timer_set_time(&ts);
+        status.synced = true;
+    }
+
+    // force reconnection
+    if ((api->keys & (HTTP_API_KEY(API_MQTTADDR) | HTTP_API_KEY(API_MQTTUSR) | HTTP_API_KEY(API_MQTTPWD))) && status.mqtt_con) {
+        mqtt_disconnect(mqtt_client);
+        status.mqtt_con = false;
+    }
+
+    if (api->keys & (HTTP_API_KEY(API_SSID) | HTTP_API_KEY(API_PASS))) {
+        status.state = ST_RETRY;
+    }
+
+    // Show the new settings
+    sched_post(SCHED_EVT_HTTP, 0, 0);
+}
+
+/**
+ * @brief Settings post failed, the reply is /api/error.json
+ *
+ * @param code status code and reason
+ * @param error reason sent
+ * @param response_uri
+ * @param response_uri_len
+ */
+static void http_api_fail(const char* code, const char* error, char* response_uri, u16_t response_uri_len)
+{
+    printf("HTTP settings %s: %s\n", code, error);
+    http_api_status = code;
+    http_api_error = error;
+    snprintf(response_uri, response_uri_len, "/api/error.json");
 }
 
 /**
@@ -648,6 +1235,7 @@ static void mqtt_incoming_data_cb(void* arg, const u8_t* data, u16_t len, u8_t f
                 config.data.mode = MODE_AUTO;
             }
             //  don't need to save as it will be controlled remotely
+            sched_post(SCHED_EVT_MQTT, TOPIC_SWITCH, config.data.mode);
 
             break;
 
@@ -731,6 +1319,17 @@ static void mqtt_connection_cb(mqtt_client_t* client, void* arg, mqtt_connection
     }
 }
 
+#if POWER_SLEEP
+/**
+ * @brief AON timer alarm, wakes the main loop for the minute update
+ *
+ */
+static void power_alarm_cb()
+{
+    sched_post(SCHED_EVT_TIMER, TIMER_MINUTE, 0);
+}
+#endif
+
 /**
  * @brief Callback which is invoked when a hostname is found.
  *
@@ -786,6 +1385,287 @@ void sntp_set_system_time_us(unsigned long sec, unsigned long us)
         .tv_nsec = us * 1000,
     };
     aon_timer_set_time(&ts);
+    status.synced = true;
+}
+
+/**
+ * @brief Request headers of a connection
+ *
+ * Kept from its first segment, started over when the connection is new in the place of a closed one. Those closed
+ * are freed first, and when all are taken the one quiet the longest is reused.
+ *
+ * @param pcb connection
+ * @return http_request_t*
+ */
+static http_request_t* http_request_find(const struct tcp_pcb* pcb)
+{
+    http_request_t* request = NULL;
+    http_request_t* oldest = NULL;
+
+    for (uint8_t i = 0; i < HTTP_REQUESTS; i++) {
+        http_request_t* entry = &http_requests[i];
+        if (entry->closed) {
+            memset(entry, 0, sizeof(*entry));
+        }
+        if (pcb == entry->pcb) {
+            request = entry;
+        } else if (!oldest || (oldest->pcb && (!entry->pcb || 0 > (s32_t)(entry->seen - oldest->seen)))) {
+            oldest = entry;
+        }
+    }
+
+    if (!request || SYN_RCVD == pcb->state) {
+        request = request ? request : oldest;
+        memset(request, 0, sizeof(*request));
+        request->pcb = pcb;
+    }
+    request->seen = sys_now();
+    return request;
+}
+
+/**
+ * @brief TCP segment received, reads the request headers of the web server connections
+ *
+ * Called by lwIP before the segment is passed on, so the headers of a request are read by the time httpd opens its
+ * file. Each connection keeps its own headers, read until the blank line after them, and the connection of the segment
+ * is the one httpd is working on until the next segment.
+ *
+ * @param pcb connection
+ * @param hdr segment header
+ * @param p segment data
+ * @return int ERR_OK to pass it on
+ */
+int http_request_hook(const struct tcp_pcb* pcb, const struct tcp_hdr* hdr, const struct pbuf* p)
+{
+    http_request = NULL;
+    if (HTTPD_SERVER_PORT == pcb->local_port) {
+        http_request = http_request_find(pcb);
+        // The rest after the headers is the body
+        for (const struct pbuf* q = p; q && !http_request->done; q = q->next) {
+            const char* data = q->payload;
+            for (u16_t i = 0; i < q->len && !http_request->done; i++) {
+                if ('\n' == data[i]) {
+                    http_request->line[http_request->len] = '\0';
+                    http_request->len = 0;
+                    http_request_header(http_request->line);
+                } else if ('\r' != data[i] && http_request->len < sizeof(http_request->line) - 1) {
+                    http_request->line[http_request->len++] = data[i];
+                }
+            }
+        }
+        if (TCPH_FLAGS(hdr) & (TCP_FIN | TCP_RST)) {
+            http_request->closed = true;
+        }
+    }
+    return ERR_OK;
+}
+
+/**
+ * @brief HTTPD POST of a settings document to /api/config
+ *
+ * httpd only takes GET and POST, other methods such as PUT are answered with /501.html.
+ *
+ * @param connection
+ * @param uri
+ * @param request
+ * @param request_len
+ * @param content_len body bytes
+ * @param response_uri file sent when refused
+ * @param response_uri_len
+ * @param post_auto_wnd
+ * @return err_t ERR_OK to receive the body
+ */
+err_t httpd_post_begin(void* connection, const char* uri, const char* request, u16_t request_len, int content_len,
+    char* response_uri, u16_t response_uri_len, u8_t* post_auto_wnd)
+{
+    err_t err = ERR_VAL;
+    if (0 != strcmp(uri, "/api/config")) {
+        http_api_fail("404 Not Found", "unknown resource", response_uri, response_uri_len);
+    } else if (HTTP_API_SIZE < content_len) {
+        http_api_fail("413 Payload Too Large", "document too large", response_uri, response_uri_len);
+    } else if (http_api.connection && HTTP_API_TIMEOUT > sys_now() - http_api.start) {
+        http_api_fail("503 Service Unavailable", "busy", response_uri, response_uri_len);
+    } else {
+        memset(&http_api, 0, sizeof(http_api));
+        http_api.connection = connection;
+        http_api.start = sys_now();
+        memcpy(&http_api.config, &config, sizeof(config));
+        json_init(&http_api.json, &http_api_keys, http_api_member, &http_api);
+        *post_auto_wnd = 1;
+        err = ERR_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief HTTPD POST body received, parsed as it comes
+ *
+ * @param connection
+ * @param p freed here
+ * @return err_t
+ */
+err_t httpd_post_receive_data(void* connection, struct pbuf* p)
+{
+    err_t err = ERR_VAL;
+    if (connection == http_api.connection) {
+        for (const struct pbuf* q = p; q && !json_parse(&http_api.json, q->payload, q->len); q = q->next) {
+        }
+        err = ERR_OK;
+    }
+    pbuf_free(p);
+    return err;
+}
+
+/**
+ * @brief HTTPD POST body ended, applied and answered 204 No Content when the whole document is good
+ *
+ * @param connection
+ * @param response_uri file sent
+ * @param response_uri_len
+ */
+void httpd_post_finished(void* connection, char* response_uri, u16_t response_uri_len)
+{
+    if (connection != http_api.connection) {
+        http_api_fail("503 Service Unavailable", "busy", response_uri, response_uri_len);
+    } else {
+        if (json_end(&http_api.json)) {
+            http_api_fail("400 Bad Request", http_api.json.err, response_uri, response_uri_len);
+        } else {
+            http_api_apply(&http_api);
+            snprintf(response_uri, response_uri_len, "/204.html");
+        }
+        http_api.connection = NULL;
+    }
+}
+
+/**
+ * @brief HTTPD custom file, the status document, or the gzip copy of a file
+ *
+ * The status is rendered whole when opened, so no SSI parsing is done on the device. data.ssi is kept for older pages
+ * and scrapers. error.json is why the last settings post failed, rendered the same. Other files are served for a GET from
+ * the gzip copy the build made of them when the request accepts gzip, and as only a 304 Not Modified header when the
+ * request If-None-Match has the ETag of the copy served. The copies and headers cannot be asked for by name.
+ *
+ * @param file
+ * @param name
+ * @return int 1 when served
+ */
+int fs_open_custom(struct fs_file* file, const char* name)
+{
+    int found = 0;
+    if (0 == strcmp(name, "/api/events")) {
+        http_sse_t* sse = http_sse_find(NULL);
+        if (sse) {
+            memset(file, 0, sizeof(*file));
+            // No data, read as events come with always more to come
+            file->len = HTTP_SSE_SIZE;
+            file->flags = FS_FILE_FLAGS_HEADER_INCLUDED;
+            *sse = (http_sse_t) { .file = file, .fresh = true, .sent = sys_now() };
+            found = 1;
+        } else {
+            printf("HTTP event streams busy\n");
+        }
+    } else if (0 == strcmp(name, "/api/status.json") || 0 == strcmp(name, "/data.ssi") || 0 == strcmp(name, "/api/error.json")) {
+        const char* (*render)(char*, int*) = strcmp(name, "/api/error.json") ? http_status_render : http_error_render;
+        for (uint8_t i = 0; !found && i < HTTP_STATUS_BUFFERS; i++) {
+            if (!http_status_used[i]) {
+                http_status_used[i] = true;
+                memset(file, 0, sizeof(*file));
+                file->data = render(http_status_buffers[i], &file->len);
+                file->index = file->len;
+                file->pextension = &http_status_used[i];
+                file->flags = FS_FILE_FLAGS_HEADER_INCLUDED;
+                found = 1;
+            }
+        }
+        if (!found) {
+            printf("HTTP status buffers busy\n");
+        }
+    } else if (!http_fs_nested && http_fs_variant(name)) {
+        // Not found, as httpd would answer
+        http_fs_nested = true;
+        found = ERR_OK == fs_open(file, "/404.html");
+        http_fs_nested = false;
+    } else if (!http_fs_nested) {
+        found = http_fs_open(file, name);
+    }
+    return found;
+}
+
+/**
+ * @brief HTTPD custom file closed, frees its status buffer or event stream
+ *
+ * @param file
+ */
+void fs_close_custom(struct fs_file* file)
+{
+    http_sse_t* sse = http_sse_find(file);
+    if (sse) {
+        sse->file = NULL;
+        sse->cbk = NULL;
+    } else if (file->pextension) {
+        *(bool*)file->pextension = false;
+        file->pextension = NULL;
+    }
+}
+
+/**
+ * @brief HTTPD custom file has data to read
+ *
+ * @param file
+ * @return u8_t 0 to wait
+ */
+u8_t fs_canread_custom(struct fs_file* file)
+{
+    http_sse_t* sse = http_sse_find(file);
+    return !sse || http_sse_render(sse, NULL, 0, false);
+}
+
+/**
+ * @brief HTTPD waits to read a custom file
+ *
+ * @param file
+ * @param callback_fn called once there is data to read
+ * @param callback_arg
+ * @return u8_t 1 when it will be called
+ */
+u8_t fs_wait_read_custom(struct fs_file* file, fs_wait_cb callback_fn, void* callback_arg)
+{
+    http_sse_t* sse = http_sse_find(file);
+    if (sse) {
+        sse->cbk = callback_fn;
+        sse->arg = callback_arg;
+    }
+    return NULL != sse;
+}
+
+/**
+ * @brief HTTPD reads a custom file without data, the event streams
+ *
+ * @param file
+ * @param buffer
+ * @param count buffer bytes
+ * @param callback_fn called once there is data to read when delayed
+ * @param callback_arg
+ * @return int bytes read, FS_READ_DELAYED or FS_READ_EOF
+ */
+int fs_read_async_custom(struct fs_file* file, char* buffer, int count, fs_wait_cb callback_fn, void* callback_arg)
+{
+    int read = FS_READ_EOF;
+    http_sse_t* sse = http_sse_find(file);
+    if (sse) {
+        read = http_sse_render(sse, buffer, count, true);
+        if (read) {
+            sse->sent = sys_now();
+            file->index += read;
+            file->len = file->index + HTTP_SSE_SIZE;
+        } else {
+            sse->cbk = callback_fn;
+            sse->arg = callback_arg;
+            read = FS_READ_DELAYED;
+        }
+    }
+    return read;
 }
 
 /**
@@ -795,6 +1675,8 @@ void sntp_set_system_time_us(unsigned long sec, unsigned long us)
  */
 int main()
 {
+    sched_evt_t evt = { .type = SCHED_EVT_MAX };
+
     while (status.run) {
         switch (status.state) {
         case ST_BOOT:
@@ -810,21 +1692,12 @@ int main()
             // Load configuration from flash
             flash_config_load(&config);
 
-            // Initialize GPIOs
-            gpio_init(BTNA);
-            gpio_set_dir(BTNA, GPIO_IN);
-            gpio_pull_up(BTNA);
-            gpio_set_irq_enabled_with_callback(BTNA, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &gpio_cb);
+            // Initialize events and keep the watchdog fed while waiting for them
+            sched_init();
+            sched_timer_start(TIMER_KEEPALIVE, WATCHDOG_KEEPALIVE, true);
 
-            gpio_init(BTNB);
-            gpio_set_dir(BTNB, GPIO_IN);
-            gpio_pull_up(BTNB);
-            gpio_set_irq_enabled_with_callback(BTNB, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &gpio_cb);
-
-            gpio_init(BTNC);
-            gpio_set_dir(BTNC, GPIO_IN);
-            gpio_pull_up(BTNC);
-            gpio_set_irq_enabled_with_callback(BTNC, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &gpio_cb);
+            // Initialize buttons
+            input_init(TIMER_INPUT);
 
             // Initializes ADC
             adc_init();
@@ -834,13 +1707,8 @@ int main()
             // Initialize the AON timer
             aon_timer_start_with_timeofday();
 
-            // Initialise the display
-            uc8151_setup();
-            uc8151_init();
-            bm_init(uc8151_draw_bitmap);
-
-            // Clear the display
-            uc8151_clear();
+            // Initialise and clear the display, drawn on core 1 from here on
+            render_init(UC8151_UPDATE_PARTIAL, DISPLAY_FULL_EVERY);
 
             // Initialize Wi-Fi
             if (cyw43_arch_init()) {
@@ -848,14 +1716,11 @@ int main()
                 status.state = ST_RESET;
                 break;
             }
+            status.wifi = true;
 
             // Start web server
-            for (int i = 0; i < LWIP_ARRAYSIZE(http_ssi_tags); i++) {
-                LWIP_ASSERT("HTTP SSI tag too long for LWIP_HTTPD_MAX_TAG_NAME_LEN", strlen(http_ssi_tags[i]) <= LWIP_HTTPD_MAX_TAG_NAME_LEN);
-            }
+            json_keys_init(&http_api_keys, http_api_names, API_MAX);
             httpd_init();
-            http_set_ssi_handler(http_ssi_handler, http_ssi_tags, LWIP_ARRAYSIZE(http_ssi_tags));
-            http_set_cgi_handlers(http_cgi_handlers, LWIP_ARRAYSIZE(http_cgi_handlers));
 
             status.state = ST_CONNECT;
 
@@ -902,14 +1767,14 @@ int main()
             }
 
             // Display title
-            bmp_printf("/monospace.bmp", 0, 0, status.name);
+            render_text(UI_TITLE, "%s", status.name);
 
             // Display wifi login qr code
-            bm_qr_printf(0, 32, "WIFI:S:%s;T:WPA;;;", status.name);
-            bmp_printf("/monospace.bmp", 96, 32, "Setup");
+            render_qr(UI_QR, "WIFI:S:%s;T:WPA;;;", status.name);
+            render_text(UI_TEMP, "Setup");
 
             // Update display
-            uc8151_refresh();
+            render_refresh();
 
             status.state = ST_WAIT;
 
@@ -932,7 +1797,7 @@ int main()
             printf("Connected.\n");
 
             // low power Wi-Fi
-            CYW43_AGGRESSIVE_PM;
+            cyw43_wifi_pm(&cyw43_state, CYW43_AGGRESSIVE_PM);
 
             // Print URL
             uint32_t ip_addr = cyw43_state.netif[CYW43_ITF_STA].ip_addr.addr;
@@ -957,108 +1822,135 @@ int main()
                 break;
             }
 
+            // First update straight away
+            sched_timer_start(TIMER_MINUTE, 0, false);
+
+#if POWER_SLEEP
+            sched_timer_start(TIMER_WIFI, POWER_WIFI_TIME, false);
+#endif
+
             status.state = ST_RUN;
 
         case ST_RUN:
-            // Normal operation poll every second
-
-            // Detect button presses
-            if (status.btna & EDGE_FALL) {
-                config.data.therm++;
-                if (!status.save) {
-                    uc8151_init();
-                    uc8151_clear();
+            // Normal operation, handle the event that woke us
+
+            // Button presses, drawn straight away and refreshed once they stop
+            if (SCHED_EVT_GPIO == evt.type || (SCHED_EVT_TIMER == evt.type && TIMER_INPUT == evt.id)) {
+                input_evt_t in;
+                while (!input_read(&in)) {
+                    bool therm = false;
+                    bool mode = false;
+
+                    if (INPUT_BTN_A == in.btn && (INPUT_PRESS == in.action || INPUT_REPEAT == in.action)) {
+                        config.data.therm++;
+                        therm = true;
+                    }
+
+                    if (INPUT_BTN_B == in.btn && INPUT_RELEASE == in.action) {
+                        config.data.mode = (config.data.mode + 1) % MODE_MAX;
+                        mode = true;
+                    }
+
+                    if (INPUT_BTN_C == in.btn && (INPUT_PRESS == in.action || INPUT_REPEAT == in.action)) {
+                        config.data.therm--;
+                        therm = true;
+                    }
+
+                    if (therm || mode) {
+                        render_wake();
+                        status.save = true;
+                        sched_timer_start(TIMER_REFRESH, DISPLAY_REFRESH_DELAY, false);
+                    }
+
+                    if (therm) {
+                        render_text(UI_TEMP, "%dC", config.data.therm);
+                    }
+
+                    if (mode) {
+                        switch (config.data.mode) {
+                        case MODE_OFF:
+                            render_asset(UI_MODE, BM_ASSET_NO_SIGN);
+                            break;
+                        case MODE_AUTO:
+                            render_asset(UI_MODE, BM_ASSET_CLOCK);
+                            break;
+                        case MODE_ON:
+                            render_asset(UI_MODE, BM_ASSET_RADIO_ON);
+                            break;
+                        default:
+                            printf("Invalid mode\n");
+                            status.state = ST_RESET;
+                        }
+                    }
                 }
-                status.save = true;
-                bmp_printf("/monospace.bmp", 96, 32, "%dC", config.data.therm);
-                uc8151_refresh();
             }
 
-            if (status.btna & EDGE_RISE) {
-                status.btna = 0;
+            if (SCHED_EVT_TIMER == evt.type && TIMER_REFRESH == evt.id) {
+                render_refresh();
             }
 
-            if (status.btnb & EDGE_RISE) {
-                status.btnb = 0;
-                config.data.mode = (config.data.mode + 1) % MODE_MAX;
-                if (!status.save) {
-                    uc8151_init();
-                    uc8151_clear();
-                }
-                status.save = true;
-                switch (config.data.mode) {
-                case MODE_OFF:
-                    bmp_draw("/no_sign.bmp", UC8151_WIDTH - 32, 48);
-                    break;
-                case MODE_AUTO:
-                    bmp_draw("/clock.bmp", UC8151_WIDTH - 32, 48);
-                    break;
-                case MODE_ON:
-                    bmp_draw("/radio_on.bmp", UC8151_WIDTH - 32, 48);
-                    break;
-                default:
-                    printf("Invalid mode\n");
-                    status.state = ST_RESET;
-                }
-                uc8151_refresh();
+            // Configuration save, a page at a time between the other events
+            if (SCHED_EVT_TIMER == evt.type && TIMER_STORE == evt.id && !store_step()) {
+                sched_timer_start(TIMER_STORE, 0, false);
             }
 
-            if (status.btnc & EDGE_FALL) {
-                config.data.therm--;
-                if (!status.save) {
-                    uc8151_init();
-                    uc8151_clear();
+#if POWER_SLEEP
+            // Power Wi-Fi down once the clock is set, the minute updates carry on without it
+            if (SCHED_EVT_TIMER == evt.type && TIMER_WIFI == evt.id) {
+                if (!status.synced) {
+                    sched_timer_start(TIMER_WIFI, POWER_WIFI_TIME, false);
+                } else {
+                    printf("Wi-Fi off\n");
+                    if (status.mqtt_con) {
+                        mqtt_disconnect(mqtt_client);
+                        status.mqtt_con = false;
+                    }
+                    cyw43_arch_deinit();
+                    status.wifi = false;
                 }
-                status.save = true;
-                bmp_printf("/monospace.bmp", 96, 32, "%dC", config.data.therm);
-                uc8151_refresh();
             }
+#endif
 
-            if (status.btnc & EDGE_RISE) {
-                status.btnc = 0;
-            }
+            // Update every minute, or straight away when MQTT or the web page changed something
+            if ((SCHED_EVT_TIMER == evt.type && TIMER_MINUTE == evt.id) || SCHED_EVT_MQTT == evt.type || SCHED_EVT_HTTP == evt.type) {
+                struct timespec ts;
+                aon_timer_get_time(&ts);
 
-            // Update every 1 min
-            struct timespec ts;
-            aon_timer_get_time(&ts);
-            struct tm* time = localtime(&ts.tv_sec);
-            if (time) {
-                static int8_t min = 100;
-                if (time->tm_min != min) {
-                    min = time->tm_min;
+                // Wake again on the minute
+                sched_timer_start(TIMER_MINUTE, (60 - ts.tv_sec % 60) * 1000 - ts.tv_nsec / 1000000, false);
 
+                struct tm* time = localtime(&ts.tv_sec);
+                if (time) {
                     // Save configuration in flash
                     if (status.save) {
                         status.save = false;
                         flash_config_save(&config);
-                    } else {
-                        uc8151_init();
                     }
 
-                    // Clear the Display
-                    uc8151_clear();
+                    // Display may have been put to sleep by the last update
+                    render_wake();
 
-                    // Display title
-                    bmp_printf("/monospace.bmp", 0, 0, status.name);
+                    // Display title, only the widgets that changed are redrawn
+                    render_text(UI_TITLE, "%s", status.name);
 
                     // Display url qr code
-                    bm_printf(font_bits, font_height, font_width, 0, UC8151_HEIGHT - 8, "http://%s", status.addr);
-                    bm_qr_printf(0, 32, "http://%s", status.addr);
+                    render_text(UI_URL, "http://%s", status.addr);
+                    render_qr(UI_QR, "http://%s", status.addr);
 
                     // Display time
-                    bmp_printf("/monospace.bmp", 96, 64, "%02d:%02d", time->tm_hour, time->tm_min);
+                    render_text(UI_TIME, "%02d:%02d", time->tm_hour, time->tm_min);
                     snprintf(status.time, sizeof(status.time), "%02d:%02d", time->tm_hour, time->tm_min);
 
                     // Read temperature
                     status.temp = 27.0f - (((float)adc_read() * 3.3f / 4096) - 0.706f) / 0.001721f;
                     printf("Onboard temperature = %.01f C\n", status.temp);
-                    bmp_printf("/monospace.bmp", 96, 32, "%.01fC", status.temp);
+                    render_text(UI_TEMP, "%.01fC", status.temp);
 
                     // Process mode
                     switch (config.data.mode) {
                     case MODE_OFF:
                         status.out = false;
-                        bmp_draw("/no_sign.bmp", UC8151_WIDTH - 32, 48);
+                        render_asset(UI_MODE, BM_ASSET_NO_SIGN);
                         break;
                     case MODE_AUTO:
                         int starthour = 0;
@@ -1069,11 +1961,11 @@ int main()
                         sscanf(config.data.timer2, "%d:%d", &endhour, &endmin);
 
                         status.out = (starthour * 60 + startmin >= time->tm_hour * 60 + time->tm_min) && (endhour * 60 + endmin <= time->tm_hour * 60 + time->tm_min) && (config.data.therm < status.temp);
-                        bmp_draw("/clock.bmp", UC8151_WIDTH - 32, 48);
+                        render_asset(UI_MODE, BM_ASSET_CLOCK);
                         break;
                     case MODE_ON:
                         status.out = true;
-                        bmp_draw("/radio_on.bmp", UC8151_WIDTH - 32, 48);
+                        render_asset(UI_MODE, BM_ASSET_RADIO_ON);
                         break;
                     default:
                         printf("Invalid mode\n");
@@ -1082,14 +1974,10 @@ int main()
 
                     // Drive output
                     out(status.out);
-                    if (status.out) {
-                        bmp_draw("/lightning.bmp", UC8151_WIDTH - 32, 88);
-                    } else {
-                        uc8151_fill_rectangle(UC8151_WIDTH - 32, 88, UC8151_WIDTH, 120, 0xff);
-                    }
+                    render_asset(UI_OUTPUT, status.out ? BM_ASSET_LIGHTNING : BM_ASSET_MAX);
 
                     // MQTT
-                    if (status.mqtt_con) {
+                    if (status.wifi && status.mqtt_con) {
                         // Publish
                         char topic[64] = "";
                         char payload[32] = "";
@@ -1103,7 +1991,7 @@ int main()
                         if (ERR_OK != mqtt_publish(mqtt_client, topic, payload, strlen(payload), 0, 0, mqtt_pub_request_cb, NULL)) {
                             printf("Publish failed\n");
                         }
-                    } else {
+                    } else if (status.wifi) {
                         // Reconnect
                         ip_addr_t mqtt_server_address = {};
                         if (ERR_OK == dns_gethostbyname(config.data.mqttaddr, &mqtt_server_address, dns_found_cb, NULL)) {
@@ -1111,13 +1999,19 @@ int main()
                         }
                     }
 
-                    // Update display
-                    uc8151_refresh();
+                    // Update display in the background, buttons waiting to refresh go with it
+                    sched_timer_stop(TIMER_REFRESH);
+                    render_refresh();
 
-                    // power down display
-                    uc8151_sleep();
+                    // power down display once refreshed
+                    render_sleep();
                 }
             }
+
+            // Push changes to the live web pages
+            if (status.wifi) {
+                http_sse_notify();
+            }
             break;
 
         case ST_RESET:
@@ -1125,6 +2019,9 @@ int main()
             if (status.save) {
                 flash_config_save(&config);
             }
+            while (!store_step()) {
+                watchdog_update();
+            }
 
             if (status.mqtt_con) {
                 mqtt_disconnect(mqtt_client);
@@ -1133,9 +2030,13 @@ int main()
             mqtt_client_free(mqtt_client);
             mqtt_client = NULL;
 
-            uc8151_sleep();
+            render_sleep();
+            render_wait();
 
-            cyw43_arch_deinit();
+            if (status.wifi) {
+                cyw43_arch_deinit();
+                status.wifi = false;
+            }
 
             printf("Waiting for reset\n");
             status.run = false;
@@ -1149,8 +2050,24 @@ int main()
         // keep alive
         watchdog_update();
 
-        // low power sleep
-        sleep_ms(POLL_INTERVAL);
+        // low power sleep until the next event while waiting for settings or running, other states move on at once
+        evt.type = SCHED_EVT_MAX;
+        if (status.run && (ST_WAIT == status.state || ST_RUN == status.state)) {
+#if POWER_SLEEP
+            // Without Wi-Fi sleep to the next minute or a button once the buttons, display and flash are done
+            if (ST_RUN == status.state && !status.wifi && !sched_pending() && !sched_timer_active(TIMER_INPUT) && !sched_timer_active(TIMER_REFRESH) && !store_busy()) {
+                struct timespec ts;
+                aon_timer_get_time(&ts);
+                ts.tv_sec += 60 - ts.tv_sec % 60;
+                ts.tv_nsec = 0;
+
+                render_wait();
+                sched_timer_stop(TIMER_MINUTE);
+                power_sleep_until(&ts, power_alarm_cb);
+            }
+#endif
+            sched_wait(&evt);
+        }
     }
 
     return 0;
@@ -0,0 +1,78 @@
+/**
+ * @file power.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Low power sleep
+ *
+ * Deep sleep gates every clock but the AON timer and the GPIO bank, so the chip wakes on the AON timer alarm or a
+ * button edge. Dormant is not used as it stops the AON timer on the RP2040 unless it is clocked from a pin.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+
+#include "hardware/clocks.h"
+#include "hardware/structs/scb.h"
+#include "hardware/sync.h"
+#include "hardware/watchdog.h"
+#include "pico/stdlib.h"
+
+#include "power.h"
+
+/* MACROS ****************************************/
+
+/**
+ * @brief Clocks left running in deep sleep
+ *
+ */
+#define POWER_SLEEP_EN0 (CLOCKS_SLEEP_EN0_CLK_RTC_RTC_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_RTC_BITS \
+    | CLOCKS_SLEEP_EN0_CLK_SYS_IO_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_PADS_BITS)
+#define POWER_SLEEP_EN1 (0)
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Deep sleep until an AON timer time or an interrupt
+ *
+ * Anything using the bus, like Wi-Fi, USB or the display, must be finished or powered down first. The watchdog is
+ * paused while asleep.
+ *
+ * @param ts wake time
+ * @param cbk alarm callback, called from the interrupt
+ * @return true
+ * @return false
+ */
+bool power_sleep_until(const struct timespec* ts, aon_timer_alarm_handler_t cbk)
+{
+    bool err = true;
+    if (!ts || !cbk) {
+        printf("Invalid wake time or callback\n");
+    } else {
+        // Let the console drain before its clock stops
+        stdio_flush();
+
+        hw_clear_bits(&watchdog_hw->ctrl, WATCHDOG_CTRL_ENABLE_BITS);
+        aon_timer_enable_alarm(ts, cbk, true);
+
+        clocks_hw->sleep_en0 = POWER_SLEEP_EN0;
+        clocks_hw->sleep_en1 = POWER_SLEEP_EN1;
+        scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+
+        __wfi();
+
+        scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+        clocks_hw->sleep_en0 = ~0u;
+        clocks_hw->sleep_en1 = ~0u;
+
+        watchdog_update();
+        hw_set_bits(&watchdog_hw->ctrl, WATCHDOG_CTRL_ENABLE_BITS);
+        err = false;
+    }
+    return err;
+}
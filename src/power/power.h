@@ -0,0 +1,22 @@
+/**
+ * @file power.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Refer to .c file
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __POWER_H__
+#define __POWER_H__
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "pico/aon_timer.h"
+
+bool power_sleep_until(const struct timespec* ts, aon_timer_alarm_handler_t cbk);
+
+#endif /* __POWER_H__ */
@@ -0,0 +1,439 @@
+/**
+ * @file render.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Display rendering on core 1
+ *
+ * Core 0 formats widget text and queues draw operations in a single producer single consumer ring, core 1 owns the
+ * display and rasterises them through ui, bm and uc8151c and sends the refreshes. When the ring is empty and the
+ * display idle core 1 stores the operations done and rings a doorbell back over the SIO FIFO, which core 0 posts as a
+ * SCHED_EVT_RENDER event. So the network on core 0 never waits for a multi-second e-paper refresh. The FIFO word only
+ * wakes core 0, the flash lockout of the store runs its handshake over the same FIFO and drops words that are not its
+ * own, so the count is never taken from it.
+ *
+ * Refreshes are deferred on core 1 until the ring is drained and the display is idle, so refreshes asked for while one
+ * is running, and the widgets drawn meanwhile, go out together in a single follow-up refresh.
+ *
+ * Both cores only wait with __wfe and each sends an event after moving its end of the ring. Core 1 is also woken by the
+ * display interrupts, so it does not block on a refresh before ringing and keeps running operations queued meanwhile.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/irq.h"
+#include "hardware/structs/scb.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+
+#include "bm.h"
+#include "render.h"
+#include "sched.h"
+#include "uc8151c.h"
+#include "ui.h"
+
+/* MACROS ****************************************/
+
+/**
+ * @brief Queued operations, power of 2
+ *
+ */
+#define RENDER_QUEUE_SIZE (16)
+#define RENDER_TEXT_SIZE (80)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Draw operations
+ *
+ */
+typedef enum {
+    RENDER_OP_TEXT, ///< ui_text()
+    RENDER_OP_QR, ///< ui_qr()
+    RENDER_OP_ASSET, ///< ui_asset()
+    RENDER_OP_WAKE, ///< uc8151_init()
+    RENDER_OP_REFRESH, ///< uc8151_refresh_async() once idle
+    RENDER_OP_SLEEP, ///< uc8151_sleep()
+} render_op_type_t;
+
+/**
+ * @brief Draw operation
+ *
+ */
+typedef struct {
+    render_op_type_t type; ///< Operation
+    ui_widget_t widget; ///< Widget drawn
+    bm_asset_t asset; ///< Asset of RENDER_OP_ASSET
+    char text[RENDER_TEXT_SIZE]; ///< Text of RENDER_OP_TEXT and RENDER_OP_QR
+} render_op_t;
+
+/* LOCAL VARIABLES ****************************************/
+
+/**
+ * @brief Operation ring
+ *
+ */
+static render_op_t render_queue[RENDER_QUEUE_SIZE];
+
+/**
+ * @brief Operations queued, only written by core 0
+ *
+ */
+static volatile uint32_t render_head = 0;
+
+/**
+ * @brief Operations done, only written by core 1
+ *
+ */
+static volatile uint32_t render_tail = 0;
+
+/**
+ * @brief Operations done at the last doorbell, only written by core 1
+ *
+ */
+static volatile uint32_t render_done = 0;
+
+/**
+ * @brief Display refresh settings for core 1
+ *
+ */
+static uc8151_update_t render_update;
+static uint8_t render_full_every;
+
+/**
+ * @brief Refresh asked for and not yet started, only used by core 1
+ *
+ */
+static bool render_dirty = false;
+
+/**
+ * @brief Display awake once the operations queued so far are done, only used by core 0
+ *
+ */
+static bool render_awake = true;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Core 0 doorbell interrupt, takes the operations done by core 1
+ *
+ */
+static void render_doorbell_irq()
+{
+    while (multicore_fifo_rvalid()) {
+        multicore_fifo_pop_blocking();
+    }
+    multicore_fifo_clear_irq();
+    sched_post(SCHED_EVT_RENDER, render_done, 0);
+}
+
+/**
+ * @brief Claim the next free operation, waiting for core 1 when the ring is full
+ *
+ * @param type
+ * @param widget
+ * @return render_op_t* fill in and pass to render_push()
+ */
+static render_op_t* render_claim(render_op_type_t type, ui_widget_t widget)
+{
+    while (RENDER_QUEUE_SIZE == render_head - render_tail) {
+        __wfe();
+    }
+    render_op_t* op = &render_queue[render_head & (RENDER_QUEUE_SIZE - 1)];
+    op->type = type;
+    op->widget = widget;
+    return op;
+}
+
+/**
+ * @brief Hand the claimed operation to core 1
+ *
+ */
+static void render_push()
+{
+    // The operation is written before core 1 sees the new head
+    __dmb();
+    render_head = render_head + 1;
+    __sev();
+}
+
+/**
+ * @brief Queue a text or QR code operation
+ *
+ * @param type
+ * @param widget
+ * @param fmt
+ * @param args
+ */
+static void render_vprintf(render_op_type_t type, ui_widget_t widget, const char* fmt, va_list args)
+{
+    render_op_t* op = render_claim(type, widget);
+    vsnprintf(op->text, sizeof(op->text), fmt, args);
+    render_push();
+}
+
+/**
+ * @brief Display refreshed interrupt on core 1, wakes the render loop
+ *
+ */
+static void render_refreshed()
+{
+    __sev();
+}
+
+/**
+ * @brief Start the deferred refresh on core 1
+ *
+ */
+static void render_flush()
+{
+    render_dirty = false;
+    uc8151_refresh_async(render_refreshed);
+}
+
+/**
+ * @brief Run one operation on core 1
+ *
+ * @param op
+ */
+static void render_run(const render_op_t* op)
+{
+    switch (op->type) {
+    case RENDER_OP_TEXT:
+        ui_text(op->widget, "%s", op->text);
+        break;
+    case RENDER_OP_QR:
+        ui_qr(op->widget, "%s", op->text);
+        break;
+    case RENDER_OP_ASSET:
+        ui_asset(op->widget, op->asset);
+        break;
+    case RENDER_OP_WAKE:
+        if (render_dirty) {
+            render_flush();
+        }
+        uc8151_init();
+        break;
+    case RENDER_OP_REFRESH:
+        render_dirty = true;
+        break;
+    case RENDER_OP_SLEEP:
+        if (render_dirty) {
+            render_flush();
+        }
+        uc8151_sleep();
+        break;
+    default:
+        printf("Invalid render operation\n");
+    }
+}
+
+/**
+ * @brief Core 1 entry, owns the display from here on
+ *
+ */
+static void render_core1()
+{
+    // Flash writes on core 0 park us
+    multicore_lockout_victim_init();
+
+    // Let the chip gate clocks when core 0 deep sleeps while we wait
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+
+    // The display interrupts and alarms are taken on this core
+    uc8151_setup();
+    uc8151_init();
+    uc8151_set_update(render_update, render_full_every);
+    bm_init(uc8151_draw_bitmap);
+    uc8151_clear();
+    ui_init();
+
+    uint32_t rung = 0;
+    while (true) {
+        if (render_tail != render_head) {
+            // Core 0 wrote the operation before moving the head
+            __dmb();
+            render_run(&render_queue[render_tail & (RENDER_QUEUE_SIZE - 1)]);
+            __dmb();
+            render_tail = render_tail + 1;
+            __sev();
+        } else if (render_dirty) {
+            // Ring empty, refresh once the last one is done
+            if (!uc8151_busy()) {
+                render_flush();
+            } else {
+                __wfe();
+            }
+        } else if (rung != render_tail) {
+            // Ring empty, ring the doorbell once the display is done, woken by its interrupts meanwhile
+            if (!uc8151_busy()) {
+                // Only reports a busy timeout now
+                uc8151_wait();
+                rung = render_tail;
+                render_done = rung;
+                __dmb();
+                __sev();
+                // Only a wake up, a full FIFO already has one pending
+                if (multicore_fifo_wready()) {
+                    multicore_fifo_push_blocking(rung);
+                }
+            } else {
+                __wfe();
+            }
+        } else {
+            __wfe();
+        }
+    }
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Start core 1 and set up the display on it
+ *
+ * @param update refresh type
+ * @param full_every partial refreshes between full refreshes
+ */
+void render_init(uc8151_update_t update, uint8_t full_every)
+{
+    render_update = update;
+    render_full_every = full_every;
+    render_head = 0;
+    render_tail = 0;
+    render_done = 0;
+    render_dirty = false;
+
+    multicore_fifo_drain();
+    multicore_fifo_clear_irq();
+    irq_set_exclusive_handler(SIO_FIFO_IRQ_NUM(0), render_doorbell_irq);
+    irq_set_enabled(SIO_FIFO_IRQ_NUM(0), true);
+
+    multicore_reset_core1();
+    multicore_launch_core1(render_core1);
+}
+
+/**
+ * @brief Draw text in a widget
+ *
+ * @param widget
+ * @param fmt
+ * @param ...
+ * @return true
+ * @return false
+ */
+bool render_text(ui_widget_t widget, const char* fmt, ...)
+{
+    bool err = true;
+    if (UI_MAX <= widget || !fmt) {
+        printf("Invalid widget or format\n");
+    } else {
+        va_list args;
+        va_start(args, fmt);
+        render_vprintf(RENDER_OP_TEXT, widget, fmt, args);
+        va_end(args);
+        err = false;
+    }
+    return err;
+}
+
+/**
+ * @brief Draw a QR code in a widget
+ *
+ * @param widget
+ * @param fmt
+ * @param ...
+ * @return true
+ * @return false
+ */
+bool render_qr(ui_widget_t widget, const char* fmt, ...)
+{
+    bool err = true;
+    if (UI_MAX <= widget || !fmt) {
+        printf("Invalid widget or format\n");
+    } else {
+        va_list args;
+        va_start(args, fmt);
+        render_vprintf(RENDER_OP_QR, widget, fmt, args);
+        va_end(args);
+        err = false;
+    }
+    return err;
+}
+
+/**
+ * @brief Draw an asset in a widget
+ *
+ * @param widget
+ * @param asset BM_ASSET_MAX to blank it
+ * @return true
+ * @return false
+ */
+bool render_asset(ui_widget_t widget, bm_asset_t asset)
+{
+    bool err = true;
+    if (UI_MAX <= widget) {
+        printf("Invalid widget\n");
+    } else {
+        render_claim(RENDER_OP_ASSET, widget)->asset = asset;
+        render_push();
+        err = false;
+    }
+    return err;
+}
+
+/**
+ * @brief Wake the display, nothing is queued when it is already awake
+ *
+ */
+void render_wake()
+{
+    if (!render_awake) {
+        render_awake = true;
+        render_claim(RENDER_OP_WAKE, UI_MAX);
+        render_push();
+    }
+}
+
+/**
+ * @brief Send the changed widgets to the display
+ *
+ * Starts once the operations before it are done and the display is idle, refreshes asked for meanwhile are merged.
+ *
+ */
+void render_refresh()
+{
+    render_claim(RENDER_OP_REFRESH, UI_MAX);
+    render_push();
+}
+
+/**
+ * @brief Put the display to sleep once refreshed, nothing is queued when it is already asleep
+ *
+ */
+void render_sleep()
+{
+    if (render_awake) {
+        render_awake = false;
+        render_claim(RENDER_OP_SLEEP, UI_MAX);
+        render_push();
+    }
+}
+
+/**
+ * @brief Wait for the doorbell of everything queued so far
+ *
+ */
+void render_wait()
+{
+    while (render_done != render_head) {
+        __wfe();
+    }
+}
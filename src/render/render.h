@@ -0,0 +1,30 @@
+/**
+ * @file render.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Refer to .c file
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "uc8151c.h"
+#include "ui.h"
+
+void render_init(uc8151_update_t update, uint8_t full_every);
+bool render_text(ui_widget_t widget, const char* fmt, ...);
+bool render_qr(ui_widget_t widget, const char* fmt, ...);
+bool render_asset(ui_widget_t widget, bm_asset_t asset);
+void render_wake();
+void render_refresh();
+void render_sleep();
+void render_wait();
+
+#endif /* __RENDER_H__ */
@@ -0,0 +1,237 @@
+/**
+ * @file sched.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Event queue and deadline timers
+ *
+ * Interrupts and callbacks post events to a small queue and the main loop waits for the next one, sleeping in __wfe
+ * until an interrupt or the earliest timer deadline. Posting sends an event so a waiting core wakes straight away.
+ * lwIP runs from the background interrupt of the cyw43 driver so it needs nothing from the wait.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+
+#include "hardware/sync.h"
+#include "pico/sync.h"
+#include "pico/time.h"
+
+#include "sched.h"
+
+/* MACROS ****************************************/
+
+/**
+ * @brief Queued events, power of 2
+ *
+ */
+#define SCHED_QUEUE_SIZE (16)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Deadline timer
+ *
+ */
+typedef struct {
+    absolute_time_t deadline; ///< Expiry
+    uint32_t period; ///< Reload in ms, 0 for one shot
+    bool active; ///< Running
+} sched_timer_t;
+
+/* LOCAL VARIABLES ****************************************/
+
+/**
+ * @brief Event ring buffer
+ *
+ */
+static sched_evt_t sched_queue[SCHED_QUEUE_SIZE];
+
+/**
+ * @brief Next free entry
+ *
+ */
+static volatile uint8_t sched_head = 0;
+
+/**
+ * @brief Oldest entry
+ *
+ */
+static volatile uint8_t sched_tail = 0;
+
+/**
+ * @brief Queue lock against interrupts and the other core
+ *
+ */
+static critical_section_t sched_lock;
+
+/**
+ * @brief Deadline timers, only used from the main loop
+ *
+ */
+static sched_timer_t sched_timers[SCHED_TIMER_MAX] = { 0 };
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Initialize the queue
+ *
+ */
+void sched_init()
+{
+    critical_section_init(&sched_lock);
+    sched_head = 0;
+    sched_tail = 0;
+}
+
+/**
+ * @brief Post an event, safe from interrupts
+ *
+ * @param type source
+ * @param id pin, timer or source defined
+ * @param data source defined
+ * @return true queue full, event dropped
+ * @return false
+ */
+bool sched_post(sched_evt_type_t type, uint32_t id, uint32_t data)
+{
+    bool err = true;
+    critical_section_enter_blocking(&sched_lock);
+    if (((sched_head + 1) & (SCHED_QUEUE_SIZE - 1)) != sched_tail) {
+        sched_queue[sched_head] = (sched_evt_t) { .type = type, .id = id, .data = data };
+        sched_head = (sched_head + 1) & (SCHED_QUEUE_SIZE - 1);
+        err = false;
+    }
+    critical_section_exit(&sched_lock);
+
+    // Wake the waiting core
+    __sev();
+    return err;
+}
+
+/**
+ * @brief Whether events are queued
+ *
+ * @return true
+ * @return false
+ */
+bool sched_pending()
+{
+    return sched_head != sched_tail;
+}
+
+/**
+ * @brief Start or restart a timer
+ *
+ * @param timer
+ * @param ms time to the deadline, 0 expires on the next wait
+ * @param periodic reload with the same time after expiring
+ * @return true
+ * @return false
+ */
+bool sched_timer_start(uint8_t timer, uint32_t ms, bool periodic)
+{
+    bool err = true;
+    if (SCHED_TIMER_MAX <= timer) {
+        printf("Invalid timer\n");
+    } else {
+        sched_timers[timer].deadline = make_timeout_time_ms(ms);
+        sched_timers[timer].period = periodic ? ms : 0;
+        sched_timers[timer].active = true;
+        err = false;
+    }
+    return err;
+}
+
+/**
+ * @brief Stop a timer
+ *
+ * @param timer
+ * @return true
+ * @return false
+ */
+bool sched_timer_stop(uint8_t timer)
+{
+    bool err = true;
+    if (SCHED_TIMER_MAX <= timer) {
+        printf("Invalid timer\n");
+    } else {
+        sched_timers[timer].active = false;
+        err = false;
+    }
+    return err;
+}
+
+/**
+ * @brief Whether a timer is running
+ *
+ * @param timer
+ * @return true
+ * @return false
+ */
+bool sched_timer_active(uint8_t timer)
+{
+    return SCHED_TIMER_MAX > timer && sched_timers[timer].active;
+}
+
+/**
+ * @brief Wait for the next event
+ *
+ * Queued events come first, then expired timers. Periodic timers reload from their deadline so they do not drift.
+ *
+ * @param evt
+ * @return true
+ * @return false
+ */
+bool sched_wait(sched_evt_t* evt)
+{
+    bool err = true;
+    if (!evt) {
+        printf("Invalid event\n");
+    } else {
+        while (err) {
+            critical_section_enter_blocking(&sched_lock);
+            if (sched_head != sched_tail) {
+                *evt = sched_queue[sched_tail];
+                sched_tail = (sched_tail + 1) & (SCHED_QUEUE_SIZE - 1);
+                err = false;
+            }
+            critical_section_exit(&sched_lock);
+
+            absolute_time_t now = get_absolute_time();
+            absolute_time_t next = at_the_end_of_time;
+            for (uint8_t i = 0; err && i < SCHED_TIMER_MAX; i++) {
+                sched_timer_t* timer = &sched_timers[i];
+                if (!timer->active) {
+                    continue;
+                }
+                if (absolute_time_diff_us(now, timer->deadline) <= 0) {
+                    *evt = (sched_evt_t) { .type = SCHED_EVT_TIMER, .id = i, .data = 0 };
+                    if (timer->period) {
+                        timer->deadline = delayed_by_ms(timer->deadline, timer->period);
+                        // Missed periods are not caught up
+                        if (absolute_time_diff_us(now, timer->deadline) <= 0) {
+                            timer->deadline = delayed_by_ms(now, timer->period);
+                        }
+                    } else {
+                        timer->active = false;
+                    }
+                    err = false;
+                } else if (absolute_time_diff_us(timer->deadline, next) > 0) {
+                    next = timer->deadline;
+                }
+            }
+
+            // Sleep until an interrupt or the next deadline, a post since the check above leaves the event set
+            if (err) {
+                best_effort_wfe_or_timeout(next);
+            }
+        }
+    }
+    return err;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file sched.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Refer to .c file
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Number of deadline timers
+ *
+ */
+#define SCHED_TIMER_MAX (8)
+
+/**
+ * @brief Event sources
+ *
+ */
+typedef enum {
+    SCHED_EVT_GPIO, ///< GPIO interrupt, id is the pin and data the events
+    SCHED_EVT_TIMER, ///< Deadline timer expired, id is the timer
+    SCHED_EVT_MQTT, ///< MQTT message changed the state
+    SCHED_EVT_HTTP, ///< Web page changed the state
+    SCHED_EVT_RENDER, ///< Display done, id is the render operations done
+    SCHED_EVT_MAX
+} sched_evt_type_t;
+
+/**
+ * @brief Event
+ *
+ */
+typedef struct {
+    sched_evt_type_t type; ///< Source
+    uint32_t id; ///< Pin, timer or source defined
+    uint32_t data; ///< Source defined
+} sched_evt_t;
+
+void sched_init();
+bool sched_post(sched_evt_type_t type, uint32_t id, uint32_t data);
+bool sched_pending();
+bool sched_timer_start(uint8_t timer, uint32_t ms, bool periodic);
+bool sched_timer_stop(uint8_t timer);
+bool sched_timer_active(uint8_t timer);
+bool sched_wait(sched_evt_t* evt);
+
+#endif /* __SCHED_H__ */
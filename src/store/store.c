@@ -0,0 +1,342 @@
+/**
+ * @file store.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Log structured configuration store in flash
+ *
+ * Each save appends a record of whole pages to the active sector: a header with a sequence number and a CRC-32 over
+ * the header and data, then the data. The valid record with the highest sequence number is the current one, so a
+ * record torn by a power loss fails its CRC and the one before it stays current. When the active sector is full the
+ * next sector round the STORE_SECTORS is erased and taken, which collects the old records in it and spreads the
+ * erases over all the sectors.
+ *
+ * store_save() only prepares the record, store_step() then erases or programs one page at a time so the flash is
+ * written between events rather than stalling the network for the whole save.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "store.h"
+#include "store_hal.h"
+
+/* MACROS ****************************************/
+
+/**
+ * @brief Record header check
+ *
+ */
+#define STORE_MAGIC (0x53544f52)
+
+/**
+ * @brief Largest record in pages
+ *
+ */
+#define STORE_RECORD_PAGES (4)
+
+#define STORE_SECTOR_PAGES (STORE_SECTOR_SIZE / STORE_PAGE_SIZE)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Record header, followed by the data
+ *
+ */
+typedef struct {
+    uint32_t magic; ///< STORE_MAGIC
+    uint32_t seq; ///< Higher is newer
+    uint32_t size; ///< Data bytes
+    uint32_t crc; ///< CRC-32 of the fields before it and the data
+} store_header_t;
+
+/**
+ * @brief Write steps
+ *
+ */
+typedef enum {
+    STORE_IDLE, ///< Nothing to write
+    STORE_ERASE, ///< Erase the sector then program
+    STORE_PROGRAM, ///< Program the next page
+} store_state_t;
+
+/* LOCAL VARIABLES ****************************************/
+
+/**
+ * @brief Record being written, padded to whole pages
+ *
+ */
+static uint8_t store_record[STORE_RECORD_PAGES * STORE_PAGE_SIZE];
+
+/**
+ * @brief Pages in the record being written
+ *
+ */
+static uint8_t store_pages = 0;
+
+/**
+ * @brief Pages of it programmed
+ *
+ */
+static uint8_t store_done = 0;
+
+/**
+ * @brief Write step
+ *
+ */
+static store_state_t store_state = STORE_IDLE;
+
+/**
+ * @brief Sector appended to
+ *
+ */
+static uint8_t store_sector = 0;
+
+/**
+ * @brief First free page in it, all pages after it are erased
+ *
+ */
+static uint8_t store_end = 0;
+
+/**
+ * @brief Highest sequence number in flash
+ *
+ */
+static uint32_t store_seq = 0;
+
+/**
+ * @brief Current record offset, STORE_SECTORS * STORE_SECTOR_SIZE for none
+ *
+ */
+static uint32_t store_current = STORE_SECTORS * STORE_SECTOR_SIZE;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief CRC-32 (IEEE 802.3)
+ *
+ * @param crc previous value, 0 to start
+ * @param data
+ * @param size
+ * @return uint32_t
+ */
+static uint32_t store_crc(uint32_t crc, const uint8_t* data, size_t size)
+{
+    crc = ~crc;
+    while (size--) {
+        crc ^= *data++;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Pages of a record
+ *
+ * @param size data bytes
+ * @return uint8_t
+ */
+static uint8_t store_record_pages(size_t size)
+{
+    return (sizeof(store_header_t) + size + STORE_PAGE_SIZE - 1) / STORE_PAGE_SIZE;
+}
+
+/**
+ * @brief Page is erased
+ *
+ * @param page
+ * @return true
+ * @return false
+ */
+static bool store_blank(const uint8_t* page)
+{
+    for (uint16_t i = 0; i < STORE_PAGE_SIZE; i++) {
+        if (0xff != page[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Whole record with a good CRC at a page
+ *
+ * @param sector
+ * @param page
+ * @return const store_header_t* NULL when not
+ */
+static const store_header_t* store_valid(uint8_t sector, uint8_t page)
+{
+    const store_header_t* header = (const store_header_t*)(store_hal_flash() + sector * STORE_SECTOR_SIZE + page * STORE_PAGE_SIZE);
+    if (STORE_MAGIC != header->magic || STORE_RECORD_PAGES * STORE_PAGE_SIZE - sizeof(store_header_t) < header->size
+        || STORE_SECTOR_PAGES < page + store_record_pages(header->size)) {
+        return NULL;
+    }
+    uint32_t crc = store_crc(0, (const uint8_t*)header, offsetof(store_header_t, crc));
+    crc = store_crc(crc, (const uint8_t*)(header + 1), header->size);
+    return crc == header->crc ? header : NULL;
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Find the current record and where to append
+ *
+ */
+void store_init()
+{
+    uint8_t end[STORE_SECTORS] = { 0 };
+
+    store_state = STORE_IDLE;
+    store_sector = 0;
+    store_seq = 0;
+    store_current = STORE_SECTORS * STORE_SECTOR_SIZE;
+
+    for (uint8_t sector = 0; sector < STORE_SECTORS; sector++) {
+        uint8_t page = 0;
+        while (page < STORE_SECTOR_PAGES) {
+            const store_header_t* header = store_valid(sector, page);
+            if (header) {
+                if (STORE_SECTORS * STORE_SECTOR_SIZE == store_current || (int32_t)(header->seq - store_seq) > 0) {
+                    store_seq = header->seq;
+                    store_sector = sector;
+                    store_current = sector * STORE_SECTOR_SIZE + page * STORE_PAGE_SIZE;
+                }
+                page += store_record_pages(header->size);
+                end[sector] = page;
+            } else if (store_blank(store_hal_flash() + sector * STORE_SECTOR_SIZE + page * STORE_PAGE_SIZE)) {
+                page++;
+            } else {
+                // Torn record or other data, never programmed again until erased
+                page++;
+                end[sector] = page;
+            }
+        }
+    }
+
+    store_end = end[store_sector];
+}
+
+/**
+ * @brief Read the current record
+ *
+ * @param data
+ * @param size bytes expected
+ * @return true no record or of another size
+ * @return false
+ */
+bool store_load(void* data, size_t size)
+{
+    bool err = true;
+    if (!data) {
+        printf("Invalid data\n");
+    } else if (STORE_SECTORS * STORE_SECTOR_SIZE == store_current) {
+        printf("No stored record\n");
+    } else {
+        const store_header_t* header = (const store_header_t*)(store_hal_flash() + store_current);
+        if (size != header->size) {
+            printf("Stored record size differs\n");
+        } else {
+            memcpy(data, header + 1, size);
+            err = false;
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Start writing a new record, written by store_step()
+ *
+ * A record still being written is left torn and replaced.
+ *
+ * @param data
+ * @param size
+ * @return true
+ * @return false
+ */
+bool store_save(const void* data, size_t size)
+{
+    bool err = true;
+    if (!data || sizeof(store_record) - sizeof(store_header_t) < size) {
+        printf("Invalid data\n");
+    } else {
+        store_header_t* header = (store_header_t*)store_record;
+        memset(store_record, 0xff, sizeof(store_record));
+        header->magic = STORE_MAGIC;
+        header->seq = store_seq + 1;
+        header->size = size;
+        memcpy(header + 1, data, size);
+        header->crc = store_crc(store_crc(0, store_record, offsetof(store_header_t, crc)), (const uint8_t*)data, size);
+
+        store_pages = store_record_pages(size);
+        store_done = 0;
+        if (STORE_SECTOR_PAGES < store_end + store_pages) {
+            // Full, take the next sector
+            store_sector = (store_sector + 1) % STORE_SECTORS;
+            store_end = 0;
+            store_state = STORE_ERASE;
+        } else if (STORE_ERASE != store_state) {
+            store_state = STORE_PROGRAM;
+        }
+        store_seq = header->seq;
+        err = false;
+    }
+    return err;
+}
+
+/**
+ * @brief Erase or program one page of the record being written
+ *
+ * @return true written, nothing more to do
+ * @return false call again
+ */
+bool store_step()
+{
+    uint32_t sector = store_sector * STORE_SECTOR_SIZE;
+
+    switch (store_state) {
+    case STORE_ERASE:
+        if (store_hal_erase(sector)) {
+            printf("Flash erase failed\n");
+            store_state = STORE_IDLE;
+        } else {
+            store_state = STORE_PROGRAM;
+        }
+        break;
+    case STORE_PROGRAM:
+        if (store_hal_program(sector + store_end * STORE_PAGE_SIZE, &store_record[store_done * STORE_PAGE_SIZE])) {
+            printf("Flash program failed\n");
+            store_state = STORE_IDLE;
+        } else {
+            store_end++;
+            if (++store_done == store_pages) {
+                store_current = sector + (store_end - store_pages) * STORE_PAGE_SIZE;
+                store_state = STORE_IDLE;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    return STORE_IDLE == store_state;
+}
+
+/**
+ * @brief Record waiting to be written
+ *
+ * @return true
+ * @return false
+ */
+bool store_busy()
+{
+    return STORE_IDLE != store_state;
+}
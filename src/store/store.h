@@ -0,0 +1,25 @@
+/**
+ * @file store.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Refer to .c file
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __STORE_H__
+#define __STORE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+void store_init();
+bool store_load(void* data, size_t size);
+bool store_save(const void* data, size_t size);
+bool store_step();
+bool store_busy();
+
+#endif /* __STORE_H__ */
@@ -0,0 +1,35 @@
+/**
+ * @file store_hal.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Flash abstraction between the store and the hardware or simulated flash
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+#ifndef __STORE_HAL_H__
+#define __STORE_HAL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Flash geometry, erased bytes read 0xff
+ *
+ */
+#define STORE_SECTOR_SIZE (4096)
+#define STORE_PAGE_SIZE (256)
+
+/**
+ * @brief Sectors used by the store
+ *
+ */
+#define STORE_SECTORS (4)
+
+// Implemented by the port
+const uint8_t* store_hal_flash();
+bool store_hal_erase(uint32_t offset);
+bool store_hal_program(uint32_t offset, const uint8_t* data);
+
+#endif /* __STORE_HAL_H__ */
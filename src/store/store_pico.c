@@ -0,0 +1,102 @@
+/**
+ * @file store_pico.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief RP2040 flash for the store
+ *
+ * Each erase or page program runs through flash_safe_execute() which parks core 1 in RAM and disables interrupts only
+ * for that one operation.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include "hardware/flash.h"
+#include "pico/flash.h"
+
+#include "store_hal.h"
+
+/* MACROS ****************************************/
+
+/**
+ * @brief Store 256k from the start of flash, where the configuration always was
+ *
+ */
+#define STORE_FLASH_OFFSET (256 * 1024)
+
+/**
+ * @brief Time to wait for core 1 to park in ms
+ *
+ */
+#define STORE_SAFE_TIMEOUT (100)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Flash operation run with core 1 parked
+ *
+ */
+typedef struct {
+    uint32_t offset; ///< From the start of the store
+    const uint8_t* data; ///< Page to program, NULL to erase the sector
+} store_pico_op_t;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Erase or program, called with core 1 parked and interrupts off
+ *
+ * @param param store_pico_op_t
+ */
+static void store_pico_run(void* param)
+{
+    const store_pico_op_t* op = param;
+    if (op->data) {
+        flash_range_program(STORE_FLASH_OFFSET + op->offset, op->data, STORE_PAGE_SIZE);
+    } else {
+        flash_range_erase(STORE_FLASH_OFFSET + op->offset, STORE_SECTOR_SIZE);
+    }
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Store mapped in the XIP address space
+ *
+ * @return const uint8_t*
+ */
+const uint8_t* store_hal_flash()
+{
+    return (const uint8_t*)(XIP_BASE + STORE_FLASH_OFFSET);
+}
+
+/**
+ * @brief Erase a sector
+ *
+ * @param offset from the start of the store
+ * @return true
+ * @return false
+ */
+bool store_hal_erase(uint32_t offset)
+{
+    store_pico_op_t op = { .offset = offset, .data = NULL };
+    return PICO_OK != flash_safe_execute(store_pico_run, &op, STORE_SAFE_TIMEOUT);
+}
+
+/**
+ * @brief Program a page
+ *
+ * @param offset from the start of the store
+ * @param data STORE_PAGE_SIZE bytes
+ * @return true
+ * @return false
+ */
+bool store_hal_program(uint32_t offset, const uint8_t* data)
+{
+    store_pico_op_t op = { .offset = offset, .data = data };
+    return PICO_OK != flash_safe_execute(store_pico_run, &op, STORE_SAFE_TIMEOUT);
+}
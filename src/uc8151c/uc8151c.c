@@ -7,6 +7,14 @@
  * X-Y axis have been swapped to landscape
  * Code does not flip the graphics from portrait to landscape so they have to be flipped manually before compilation.
  *
+ * Drawing goes to a RAM framebuffer, changed windows are tracked and only those are sent to the display on refresh.
+ *
+ * Commands are queued and sent in the background, data is streamed by DMA and the BUSY pin interrupt sequences
+ * the commands that have to wait for the controller, so refreshing does not block the caller.
+ *
+ * Besides the OTP full refresh waveform, register LUTs give a fast full refresh and a partial refresh of the changed
+ * windows only, with a full refresh every few partial ones to clear the ghosting.
+ *
  * @version 0.1
  * @date 2024-03-05
  *
@@ -16,181 +24,686 @@
 
 /* INCLUDES ****************************************/
 
-#include "hardware/gpio.h"
-#include "hardware/spi.h"
-#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
 
 #include "uc8151c.h"
+#include "uc8151c_hal.h"
 
 /* MACROS ****************************************/
 
-#define UC8151_SPI_PORT (spi0)
+#ifndef MIN
+#define MIN(a, b) ((b) > (a) ? (a) : (b))
+#endif
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+/**
+ * @brief Bytes in one hardware line, a landscape column
+ *
+ */
+#define UC8151_LINE_SIZE (UC8151_HEIGHT / 8)
+
+/**
+ * @brief Maximum number of dirty windows tracked before they are merged
+ *
+ */
+#define UC8151_DIRTY_MAX (4)
+
+/**
+ * @brief Queued commands, must be a power of 2
+ *
+ */
+#define UC8151_QUEUE_SIZE (32)
+
+/**
+ * @brief Command parameters stored in the queue
+ *
+ */
+#define UC8151_ARGS_SIZE (8)
+
+/**
+ * @brief Maximum time in ms the display can hold the BUSY pin LOW
+ *
+ */
+#define UC8151_BUSY_TIMEOUT (10000)
+
+/**
+ * @brief Size of the VCOM LUT
+ *
+ */
+#define UC8151_LUT_VCOM_SIZE (44)
+
+/**
+ * @brief Size of the pixel transition LUTs
+ *
+ */
+#define UC8151_LUT_SIZE (42)
+
+// RES_128x296 | FORMAT_BW | BOOSTER_ON | RESET_NONE | LUT_OTP | SHIFT_RIGHT | SCAN_DOWN
+#define UC8151_PSR_LUT_OTP (0b10010111)
+
+// RES_128x296 | FORMAT_BW | BOOSTER_ON | RESET_NONE | LUT_REG | SHIFT_RIGHT | SCAN_DOWN
+#define UC8151_PSR_LUT_REG (0b10110111)
 
 /* TYPES ****************************************/
 
-/*
- * Command registers available from the manufacturer documentation
- */
-enum uc8151_reg {
-    UC8151_PANEL_SETTING = 0x00,
-    UC8151_POWER_SETTING = 0x01,
-    UC8151_POWER_OFF = 0x02,
-    UC8151_POWER_OFF_SEQUENCE_SETTING = 0x03,
-    UC8151_POWER_ON = 0x04,
-    UC8151_POWER_ON_MEASURE = 0x05,
-    UC8161_BOOSTER_SOFT_START = 0x06,
-    UC8151_DEEP_SLEEP = 0x07,
-    UC8151_DATA_START_TRANSMISSION_1 = 0x10,
-    UC8151_DATA_STOP = 0x11,
-    UC8151_DISPLAY_REFRESH = 0x12,
-    UC8151_DATA_START_TRANSMISSION_2 = 0x13,
-    UC8151_PLL_CONTROL = 0x30,
-    UC8151_TEMPERATURE_SENSOR_COMMAND = 0x40,
-    UC8151_TEMPERATURE_SENSOR_CALIBRATION = 0x41,
-    UC8151_TEMPERATURE_SENSOR_WRITE = 0x42,
-    UC8151_TEMPERATURE_SENSOR_READ = 0x43,
-    UC8151_VCOM_AND_DATA_INTERVAL_SETTING = 0x50,
-    UC8151_LOW_POWER_DETECTION = 0x51,
-    UC8151_TCON_SETTING = 0x60,
-    UC8151_TCON_RESOLUTION = 0x61,
-    UC8151_SOURCE_AND_GATE_START_SETTING = 0x62,
-    UC8151_GET_STATUS = 0x71,
-    UC8151_AUTO_MEASURE_VCOM = 0x80,
-    UC8151_VCOM_VALUE = 0x81,
-    UC8151_VCM_DC_SETTING_REGISTER = 0x82,
-    UC8151_PARTIAL_WINDOW = 0x90,
-    UC8151_PARTIAL_IN = 0x91,
-    UC8151_PARTIAL_OUT = 0x92,
-    UC8151_PROGRAM_MODE = 0xA0,
-    UC8151_ACTIVE_PROGRAMMING = 0xA1,
-    UC8151_READ_OTP = 0xA2,
-    UC8151_POWER_SAVING = 0xE3
-};
+/**
+ * @brief Dirty window in the framebuffer
+ *
+ * Horizontal lines are in pixels, vertical channels are in bytes as the controller windows are byte aligned.
+ */
+typedef struct {
+    uint16_t x1; ///< First horizontal line
+    uint16_t x2; ///< Last horizontal line
+    uint8_t y1; ///< First vertical channel byte
+    uint8_t y2; ///< Last vertical channel byte
+} uc8151_rect_t;
 
 /**
- * @brief Interface pins with our standard defaults where appropriate
- *
- */
-enum pin {
-    A = 12,
-    B = 13,
-    C = 14,
-    D = 15,
-    E = 11,
-    UP = 15, // alias for D
-    DOWN = 11, // alias for E
-    USER = 23,
-    CS = 17,
-    CLK = 18,
-    MOSI = 19,
-    DC = 20,
-    RESET = 21,
-    BUSY = 26,
-    VBUS_DETECT = 24,
-    LED = 25,
-    BATTERY = 29,
-    ENABLE_3V3 = 10
-};
+ * @brief Queued command options
+ *
+ */
+typedef enum {
+    UC8151_OP_BUSY = 0x1, ///< Wait for the display to release the BUSY pin after the command
+    UC8151_OP_FILL = 0x2, ///< Repeat the first data byte
+} uc8151_op_flags_t;
+
+/**
+ * @brief Queued command with its data transmission
+ *
+ * Data is sent as count chunks of size bytes, each stride bytes apart in the source.
+ */
+typedef struct {
+    uint8_t command; ///< Command register
+    uint8_t flags; ///< uc8151_op_flags_t
+    uint8_t args[UC8151_ARGS_SIZE]; ///< Short parameters copied in the queue
+    const uint8_t* data; ///< Data source
+    uint16_t size; ///< Bytes per chunk
+    uint16_t count; ///< Number of chunks
+    uint16_t stride; ///< Source distance between chunks
+    uc8151_done_cbk_t cbk; ///< Called once the command has completed
+} uc8151_op_t;
+
+/**
+ * @brief Register LUTs of a waveform
+ *
+ * Each 6 byte group is the levels of 4 phases followed by their frame counts and the group repeat,
+ * transitions only depend on the new pixel so no old data has to be sent.
+ */
+typedef struct {
+    uint8_t vcom[UC8151_LUT_VCOM_SIZE]; ///< Common electrode
+    uint8_t white[UC8151_LUT_SIZE]; ///< Pixels becoming white, used for WW and BW
+    uint8_t black[UC8151_LUT_SIZE]; ///< Pixels becoming black, used for WB and BB
+} uc8151_lut_t;
 
 /* FUNCTION PROTOTYPES ****************************************/
 
+static void uc8151_op_start();
+
 /* GLOBAL VARIABLES ****************************************/
 
 /* LOCAL VARIABLES ****************************************/
 
-static spi_inst_t* spi = UC8151_SPI_PORT;
+/**
+ * @brief Shadow of the display RAM in the hardware raster
+ *
+ * One line of UC8151_LINE_SIZE bytes per landscape column, MSB at the top.
+ */
+static uint8_t uc8151_fb[UC8151_WIDTH * UC8151_LINE_SIZE];
+
+/**
+ * @brief Windows changed since the last refresh
+ *
+ */
+static uc8151_rect_t uc8151_dirty[UC8151_DIRTY_MAX];
+
+/**
+ * @brief Number of used dirty windows
+ *
+ */
+static uint8_t uc8151_dirty_count = 0;
+
+/**
+ * @brief Command queue, filled by the caller and emptied from the interrupts
+ *
+ */
+static uc8151_op_t uc8151_queue[UC8151_QUEUE_SIZE];
+
+/**
+ * @brief Queue write index
+ *
+ */
+static volatile uint8_t uc8151_head = 0;
+
+/**
+ * @brief Queue read index, command in progress
+ *
+ */
+static volatile uint8_t uc8151_tail = 0;
+
+/**
+ * @brief A command is in progress
+ *
+ */
+static volatile bool uc8151_running = false;
+
+/**
+ * @brief Waiting for the BUSY pin after a command
+ *
+ */
+static volatile bool uc8151_waiting = false;
+
+/**
+ * @brief BUSY pin released since the command was started
+ *
+ */
+static volatile bool uc8151_released = false;
+
+/**
+ * @brief The last BUSY wait ran out of time
+ *
+ */
+static volatile bool uc8151_timeout = false;
+
+/**
+ * @brief Chunk of the command data in progress
+ *
+ */
+static uint16_t uc8151_chunk = 0;
+
+/**
+ * @brief Register waveforms, indexed by uc8151_update_t
+ *
+ */
+static const uc8151_lut_t uc8151_luts[UC8151_UPDATE_MAX] = {
+    [UC8151_UPDATE_FAST] = {
+        // Short flash to black, shake and drive to the new level
+        .vcom = {
+            0x00, 0x04, 0x04, 0x07, 0x00, 0x01,
+            0x00, 0x0c, 0x0c, 0x00, 0x00, 0x02,
+            0x00, 0x04, 0x04, 0x07, 0x00, 0x02,
+        },
+        .white = {
+            0x54, 0x04, 0x04, 0x07, 0x00, 0x01,
+            0x60, 0x0c, 0x0c, 0x00, 0x00, 0x02,
+            0xa8, 0x04, 0x04, 0x07, 0x00, 0x02,
+        },
+        .black = {
+            0xa8, 0x04, 0x04, 0x07, 0x00, 0x01,
+            0x60, 0x0c, 0x0c, 0x00, 0x00, 0x02,
+            0x54, 0x04, 0x04, 0x07, 0x00, 0x02,
+        },
+    },
+    [UC8151_UPDATE_PARTIAL] = {
+        // Drive to the new level only, no flash
+        .vcom = {
+            0x00, 0x04, 0x04, 0x07, 0x00, 0x01,
+        },
+        .white = {
+            0xa8, 0x04, 0x04, 0x07, 0x00, 0x01,
+        },
+        .black = {
+            0x54, 0x04, 0x04, 0x07, 0x00, 0x01,
+        },
+    },
+};
+
+/**
+ * @brief Selected update mode
+ *
+ */
+static uc8151_update_t uc8151_mode = UC8151_UPDATE_FULL;
+
+/**
+ * @brief Partial updates between full refreshes, 0 never forces a full refresh
+ *
+ */
+static uint8_t uc8151_full_every = 0;
+
+/**
+ * @brief Partial updates since the last full refresh
+ *
+ */
+static uint8_t uc8151_partials = 0;
+
+/**
+ * @brief Waveform loaded in the controller, UC8151_UPDATE_MAX when unknown
+ *
+ */
+static uc8151_update_t uc8151_waveform = UC8151_UPDATE_MAX;
+
+/**
+ * @brief The display RAM holds the framebuffer outside the dirty windows
+ *
+ */
+static bool uc8151_ram_valid = false;
 
 /* LOCAL FUNCTIONS ****************************************/
 
-static void uc8151_write(uint8_t command, uint8_t* data, size_t size)
+/**
+ * @brief Retire the command in progress and start the next queued one
+ *
+ */
+static void uc8151_op_complete()
 {
-    // Chip Select line LOW
-    gpio_put(CS, 0);
+    uc8151_op_t* op = &uc8151_queue[uc8151_tail];
+    uc8151_done_cbk_t cbk = op->cbk;
+
+    uc8151_tail = (uc8151_tail + 1) & (UC8151_QUEUE_SIZE - 1);
+    if (uc8151_head != uc8151_tail) {
+        uc8151_op_start();
+    } else {
+        uc8151_running = false;
+    }
 
-    // Pull the command AND chip select lines LOW
-    gpio_put(DC, 0); // command mode
+    if (cbk) {
+        cbk();
+    }
+}
 
-    // Send data to the SPI register
-    spi_write_blocking(spi, (const uint8_t*)&command, 1);
+/**
+ * @brief End the SPI transaction of the command in progress
+ *
+ */
+static void uc8151_op_end()
+{
+    uc8151_op_t* op = &uc8151_queue[uc8151_tail];
 
-    if (data && size) {
-        // CMD pin HIGH
-        gpio_put(DC, 1); // data mode
+    // Let the last bytes leave and return chip select to HIGH
+    uc8151_hal_stream_end();
+    uc8151_hal_select(false);
 
-        // Write data to the device SPI buffer
-        spi_write_blocking(spi, data, size);
+    if (UC8151_DEEP_SLEEP == op->command) {
+        // Don't power the controller through the interface
+        uc8151_hal_park();
     }
 
-    // Return chip select to HIGH
-    gpio_put(CS, 1);
+    if ((op->flags & UC8151_OP_BUSY) && !uc8151_released) {
+        uc8151_waiting = true;
+        uc8151_hal_alarm(UC8151_BUSY_TIMEOUT);
+    } else {
+        uc8151_op_complete();
+    }
 }
 
-static void uc8151_fill(uint8_t command, uint8_t data, size_t size)
+/**
+ * @brief Send the command at the queue tail and start its data transfer
+ *
+ */
+static void uc8151_op_start()
 {
-    // Chip Select line LOW
-    gpio_put(CS, 0);
+    uc8151_op_t* op = &uc8151_queue[uc8151_tail];
 
-    // Pull the command AND chip select lines LOW
-    gpio_put(DC, 0); // command mode
+    uc8151_running = true;
 
-    // Send data to the SPI register
-    spi_write_blocking(spi, (const uint8_t*)&command, 1);
+    if (op->flags & UC8151_OP_BUSY) {
+        // Catch the release from the start as quick commands may not be seen LOW
+        uc8151_released = false;
+        uc8151_hal_busy_arm(true);
+    }
 
-    // CMD pin HIGH
-    gpio_put(DC, 1); // data mode
+    // Chip Select line LOW and send the command
+    uc8151_hal_select(true);
+    uc8151_hal_command(op->command);
 
-    for (uint16_t i = 0; i < size; i++) {
-        // Write data to the device SPI buffer
-        spi_write_blocking(spi, &data, 1);
+    if (op->data && op->size && op->count) {
+        // Stream the data, continued from uc8151_stream_done()
+        uc8151_chunk = 0;
+        uc8151_hal_stream(op->data, op->size, op->flags & UC8151_OP_FILL);
+    } else {
+        uc8151_op_end();
     }
+}
 
-    // Return chip select to HIGH
-    gpio_put(CS, 1);
+/**
+ * @brief Queue a command, starts sending it when the display is idle
+ *
+ * Short single chunk data is copied into the queue, otherwise data must stay valid until the command completes.
+ *
+ * @param command command register
+ * @param data data to send after the command, NULL for none
+ * @param size bytes per chunk
+ * @param count number of chunks
+ * @param stride source distance between chunks
+ * @param flags uc8151_op_flags_t
+ * @param cbk called when the command has completed, NULL for none
+ */
+static void uc8151_queue_op(uint8_t command, const uint8_t* data, uint16_t size, uint16_t count, uint16_t stride, uint8_t flags, uc8151_done_cbk_t cbk)
+{
+    // Wait for room in the queue, emptied from the interrupts
+    while (((uc8151_head + 1) & (UC8151_QUEUE_SIZE - 1)) == uc8151_tail) {
+    }
+
+    uc8151_op_t* op = &uc8151_queue[uc8151_head];
+    op->command = command;
+    op->flags = flags;
+    op->data = data;
+    op->size = size;
+    op->count = count;
+    op->stride = stride;
+    op->cbk = cbk;
+    if (data && 1 == count && (flags & UC8151_OP_FILL ? 1 : size) <= UC8151_ARGS_SIZE) {
+        memcpy(op->args, data, flags & UC8151_OP_FILL ? 1 : size);
+        op->data = op->args;
+    }
+
+    uint32_t state = uc8151_hal_lock();
+    uc8151_head = (uc8151_head + 1) & (UC8151_QUEUE_SIZE - 1);
+    if (!uc8151_running) {
+        uc8151_op_start();
+    }
+    uc8151_hal_unlock(state);
 }
 
 /**
- * @brief Waits until the display pulls the busy pin HIGH.
+ * @brief Queue a command with its parameters
+ *
+ * @param command command register
+ * @param data parameters, NULL for none
+ * @param size parameters size
+ */
+static void uc8151_write(uint8_t command, const uint8_t* data, size_t size)
+{
+    uc8151_queue_op(command, data, size, 1, 0, 0, NULL);
+}
+
+/**
+ * @brief Queue a framebuffer window as one data transmission
+ *
+ * A window of a single value is sent as a repeated byte.
+ *
+ * @param rect window to send
+ */
+static void uc8151_write_window(const uc8151_rect_t* rect)
+{
+    const uint8_t* data = &uc8151_fb[rect->x1 * UC8151_LINE_SIZE + rect->y1];
+    uint16_t lines = rect->x2 - rect->x1 + 1;
+    uint16_t size = rect->y2 - rect->y1 + 1;
+    bool fill = true;
+
+    for (uint16_t x = 0; fill && x < lines; x++) {
+        for (uint16_t y = 0; fill && y < size; y++) {
+            fill = data[x * UC8151_LINE_SIZE + y] == data[0];
+        }
+    }
+
+    if (fill) {
+        uc8151_queue_op(UC8151_DATA_START_TRANSMISSION_2, data, lines * size, 1, 0, UC8151_OP_FILL, NULL);
+    } else if (UC8151_LINE_SIZE == size) {
+        // Whole lines are contiguous in the framebuffer
+        uc8151_queue_op(UC8151_DATA_START_TRANSMISSION_2, data, lines * size, 1, 0, 0, NULL);
+    } else {
+        uc8151_queue_op(UC8151_DATA_START_TRANSMISSION_2, data, size, lines, UC8151_LINE_SIZE, 0, NULL);
+    }
+}
+
+/**
+ * @brief Waits until the queued commands are sent and the display released the BUSY pin.
  *
  */
 static void uc8151_busy_wait()
 {
-    // TODO: include a timeout
-    while (!gpio_get(BUSY)) {
-        sleep_ms(2);
-    };
+    uint32_t start = uc8151_hal_millis();
+
+    while (uc8151_running) {
+        if (uc8151_hal_millis() - start > 2 * UC8151_BUSY_TIMEOUT) {
+            printf("Display queue stuck\n");
+
+            // Drop the queue so the display can be initialised again
+            uint32_t state = uc8151_hal_lock();
+            uc8151_hal_abort();
+            uc8151_waiting = false;
+            uc8151_running = false;
+            uc8151_tail = uc8151_head;
+            uc8151_hal_unlock(state);
+            break;
+        }
+        uc8151_hal_sleep_ms(1);
+    }
+
+    if (uc8151_timeout) {
+        uc8151_timeout = false;
+        printf("Display busy timeout\n");
+    }
+}
+
+/**
+ * @brief Area of a window in framebuffer bytes
+ *
+ * @param rect window
+ * @return uint32_t
+ */
+static uint32_t uc8151_rect_area(const uc8151_rect_t* rect)
+{
+    return (uint32_t)(rect->x2 - rect->x1 + 1) * (rect->y2 - rect->y1 + 1);
+}
+
+/**
+ * @brief Grow a window to also cover another
+ *
+ * @param rect window to grow
+ * @param add window to cover
+ */
+static void uc8151_rect_union(uc8151_rect_t* rect, const uc8151_rect_t* add)
+{
+    rect->x1 = MIN(rect->x1, add->x1);
+    rect->x2 = MAX(rect->x2, add->x2);
+    rect->y1 = MIN(rect->y1, add->y1);
+    rect->y2 = MAX(rect->y2, add->y2);
+}
+
+/**
+ * @brief Record a changed framebuffer area to be sent on the next refresh
+ *
+ * Overlapping or touching windows are merged, when out of windows the one growing the least absorbs the area.
+ *
+ * @param x1 first horizontal line
+ * @param x2 last horizontal line
+ * @param y1 first vertical channel byte
+ * @param y2 last vertical channel byte
+ */
+static void uc8151_mark_dirty(uint16_t x1, uint16_t x2, uint8_t y1, uint8_t y2)
+{
+    uc8151_rect_t add = { .x1 = x1, .x2 = x2, .y1 = y1, .y2 = y2 };
+    uint8_t best = 0;
+    uint32_t best_growth = UINT32_MAX;
+
+    for (uint8_t i = 0; i < uc8151_dirty_count; i++) {
+        uc8151_rect_t* rect = &uc8151_dirty[i];
+        if (add.x1 <= rect->x2 + 1 && rect->x1 <= add.x2 + 1 && add.y1 <= rect->y2 + 1 && rect->y1 <= add.y2 + 1) {
+            uc8151_rect_union(rect, &add);
+            return;
+        }
+        uc8151_rect_t merged = *rect;
+        uc8151_rect_union(&merged, &add);
+        uint32_t growth = uc8151_rect_area(&merged) - uc8151_rect_area(rect);
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+
+    if (UC8151_DIRTY_MAX > uc8151_dirty_count) {
+        uc8151_dirty[uc8151_dirty_count++] = add;
+    } else {
+        uc8151_rect_union(&uc8151_dirty[best], &add);
+    }
+}
+
+/**
+ * @brief Queue the partial window commands
+ *
+ * @param rect window
+ */
+static void uc8151_write_partial_window(const uc8151_rect_t* rect)
+{
+    uc8151_write(UC8151_PARTIAL_WINDOW, (uint8_t[]) {
+                                            // Start verical channel
+                                            (rect->y1 * 8),
+                                            // End verical channel
+                                            (rect->y2 * 8 + 0b111),
+                                            // Start horizontal line [8]
+                                            (rect->x1 >> 8),
+                                            // Start horizontal line [7:0]
+                                            (rect->x1),
+                                            // End horizontal line [8]
+                                            (rect->x2 >> 8),
+                                            // End horizontal line [7:0]
+                                            (rect->x2),
+                                            // Scan inside + outside
+                                            (0x01),
+                                        },
+        7);
+}
+
+/**
+ * @brief Send the dirty windows of the framebuffer to the display RAM
+ *
+ * With refresh, all the windows are loaded first and then driven by a single refresh of the window bounding them.
+ * The display RAM inside it but outside the dirty windows already matches the panel so it is driven unchanged, unless
+ * the RAM was lost on reset in which case the whole bounding window is loaded.
+ *
+ * @param refresh refresh the windows instead of the whole display
+ * @param cbk called once the refresh is done, NULL for none
+ */
+static void uc8151_flush(bool refresh, uc8151_done_cbk_t cbk)
+{
+    uc8151_rect_t bounds = uc8151_dirty[0];
+
+    for (uint8_t i = 1; i < uc8151_dirty_count; i++) {
+        uc8151_rect_union(&bounds, &uc8151_dirty[i]);
+    }
+
+    if (refresh && !uc8151_ram_valid && uc8151_dirty_count) {
+        uc8151_dirty[0] = bounds;
+        uc8151_dirty_count = 1;
+    }
+
+    // A single window is refreshed as it is loaded
+    bool single = refresh && 1 == uc8151_dirty_count;
+
+    for (uint8_t i = 0; i < uc8151_dirty_count; i++) {
+        uc8151_rect_t* rect = &uc8151_dirty[i];
+
+        if (!single && 0 == rect->x1 && UC8151_WIDTH - 1 == rect->x2 && 0 == rect->y1 && UC8151_LINE_SIZE - 1 == rect->y2) {
+            // Whole frame, no window needed
+            uc8151_write_window(rect);
+            continue;
+        }
+
+        // partial frame command
+        uc8151_write(UC8151_PARTIAL_IN, NULL, 0);
+        uc8151_write_partial_window(rect);
+        uc8151_write_window(rect);
+
+        if (single) {
+            uc8151_queue_op(UC8151_DISPLAY_REFRESH, NULL, 0, 0, 0, UC8151_OP_BUSY, NULL);
+            uc8151_queue_op(UC8151_PARTIAL_OUT, NULL, 0, 0, 0, 0, cbk);
+            cbk = NULL;
+        } else {
+            // End partial frame
+            uc8151_write(UC8151_PARTIAL_OUT, NULL, 0);
+        }
+    }
+
+    if (refresh && !single && uc8151_dirty_count) {
+        // Only the bounding window is driven, once
+        uc8151_write(UC8151_PARTIAL_IN, NULL, 0);
+        uc8151_write_partial_window(&bounds);
+        uc8151_queue_op(UC8151_DISPLAY_REFRESH, NULL, 0, 0, 0, UC8151_OP_BUSY, NULL);
+        uc8151_queue_op(UC8151_PARTIAL_OUT, NULL, 0, 0, 0, 0, cbk);
+    } else if (cbk) {
+        cbk();
+    }
+    uc8151_dirty_count = 0;
+}
+
+/**
+ * @brief Select the refresh waveform in the controller
+ *
+ * Register LUTs are only sent when they are not already loaded.
+ *
+ * @param waveform update mode to load the waveform of
+ */
+static void uc8151_load_waveform(uc8151_update_t waveform)
+{
+    if (waveform == uc8151_waveform) {
+        return;
+    }
+
+    if (UC8151_UPDATE_FULL == waveform) {
+        uc8151_write(UC8151_PANEL_SETTING, (uint8_t[]) { UC8151_PSR_LUT_OTP }, 1);
+    } else {
+        const uc8151_lut_t* lut = &uc8151_luts[waveform];
+        uc8151_write(UC8151_PANEL_SETTING, (uint8_t[]) { UC8151_PSR_LUT_REG }, 1);
+        uc8151_write(UC8151_LUT_VCOM, lut->vcom, sizeof(lut->vcom));
+        uc8151_write(UC8151_LUT_WW, lut->white, sizeof(lut->white));
+        uc8151_write(UC8151_LUT_BW, lut->white, sizeof(lut->white));
+        uc8151_write(UC8151_LUT_WB, lut->black, sizeof(lut->black));
+        uc8151_write(UC8151_LUT_BB, lut->black, sizeof(lut->black));
+    }
+    uc8151_waveform = waveform;
 }
 
 /* GLOBAL FUCNTIONS ****************************************/
 
 /**
- * @brief Setup ports for UC8151C
+ * @brief Data transfer done, continues with the next chunk or ends the command
  *
+ * Called by the port, from interrupt on hardware.
  */
-void uc8151_setup()
+void uc8151_stream_done()
 {
-    // configure spi interface and pins
-    spi_init(spi, 12000000);
+    const uc8151_op_t* op = &uc8151_queue[uc8151_tail];
 
-    // SET control pins for the display HIGH (they are active LOW)
-    gpio_set_function(DC, GPIO_FUNC_SIO);
-    gpio_set_dir(DC, GPIO_OUT);
+    if (++uc8151_chunk < op->count) {
+        uc8151_hal_stream(&op->data[uc8151_chunk * op->stride], op->size, op->flags & UC8151_OP_FILL);
+    } else {
+        uc8151_op_end();
+    }
+}
 
-    gpio_set_function(CS, GPIO_FUNC_SIO);
-    gpio_set_dir(CS, GPIO_OUT);
-    gpio_put(CS, 1);
+/**
+ * @brief The display released the BUSY pin, it finished the command
+ *
+ * Called by the port, from interrupt on hardware.
+ */
+void uc8151_busy_released()
+{
+    uc8151_released = true;
 
-    // Bring the RESX pin HIGH.
-    gpio_set_function(RESET, GPIO_FUNC_SIO);
-    gpio_set_dir(RESET, GPIO_OUT);
-    gpio_put(RESET, 1);
+    if (uc8151_waiting) {
+        uc8151_waiting = false;
+        uc8151_hal_alarm_cancel();
+        uc8151_op_complete();
+    }
+}
 
-    //**make sure to set the BUSY pin as INPUT in your main setup**
-    gpio_set_function(BUSY, GPIO_FUNC_SIO);
-    gpio_set_dir(BUSY, GPIO_IN);
-    gpio_set_pulls(BUSY, true, false);
+/**
+ * @brief The display held the BUSY pin for too long
+ *
+ * Called by the port, from interrupt on hardware.
+ */
+void uc8151_busy_expired()
+{
+    if (uc8151_waiting) {
+        uc8151_waiting = false;
+        uc8151_hal_busy_arm(false);
+        uc8151_timeout = uc8151_hal_busy();
+        uc8151_op_complete();
+    }
+}
 
-    gpio_set_function(CLK, GPIO_FUNC_SPI);
-    gpio_set_function(MOSI, GPIO_FUNC_SPI);
+/**
+ * @brief Setup ports for UC8151C
+ *
+ */
+void uc8151_setup()
+{
+    uc8151_hal_setup();
 }
 
 /**
@@ -205,17 +718,33 @@ void uc8151_init()
 
     uc8151_write(UC8151_POWER_SETTING, (uint8_t[]) { 0x03, 0x00, 0x2B, 0x2B, 0x09 }, 5);
 
-    uc8151_write(UC8151_POWER_ON, NULL, 0);
-    uc8151_busy_wait();
+    uc8151_queue_op(UC8151_POWER_ON, NULL, 0, 0, 0, UC8151_OP_BUSY, NULL);
 
-    // RES_128x296 | FORMAT_BW | BOOSTER_ON | RESET_NONE | LUT_OTP | SHIFT_RIGHT | SCAN_DOWN
-    uc8151_write(UC8151_PANEL_SETTING, (uint8_t[]) { 0b10010111 }, 1);
+    uc8151_write(UC8151_PANEL_SETTING, (uint8_t[]) { UC8151_PSR_LUT_OTP }, 1);
+    uc8151_waveform = UC8151_UPDATE_FULL;
 
     uc8151_write(UC8151_TCON_SETTING, (uint8_t[]) { 0x22 }, 1);
 
     uc8151_write(UC8151_VCOM_AND_DATA_INTERVAL_SETTING, (uint8_t[]) { 0x9c }, 1);
 
     uc8151_write(UC8151_TCON_SETTING, (uint8_t[]) { 0x01 }, 1);
+
+    // Display RAM is lost on reset, send the whole framebuffer on the next full refresh
+    uc8151_ram_valid = false;
+}
+
+/**
+ * @brief Select how uc8151_refresh() updates the display
+ *
+ * @param mode waveform and area of the updates
+ * @param full_every do a full refresh after this many partial updates to clear ghosting, 0 for never
+ */
+void uc8151_set_update(uc8151_update_t mode, uint8_t full_every)
+{
+    if (UC8151_UPDATE_MAX > mode) {
+        uc8151_mode = mode;
+        uc8151_full_every = full_every;
+    }
 }
 
 /**
@@ -224,16 +753,17 @@ void uc8151_init()
  */
 void uc8151_reset()
 {
+    uc8151_busy_wait();
+
     // Do this by cycling the reset pin
-    gpio_put(RESET, 0);
-    sleep_ms(10);
-    gpio_put(RESET, 1);
-    sleep_ms(10);
+    uc8151_hal_reset();
 }
 
 /**
- * @brief Sets the draw area on the display SRAM.
- * You can keep drawing to RAM and then use uc8151_refresh() to update the display.
+ * @brief Draws a bitmap to the framebuffer.
+ * You can keep drawing and then use uc8151_refresh() to send the changed windows and update the display.
+ *
+ * The bitmap is in the hardware raster, y is rounded down to a byte boundary.
  *
  * @param data
  * @param width
@@ -243,36 +773,23 @@ void uc8151_reset()
  */
 void uc8151_draw_bitmap(uint8_t* data, uint16_t width, uint16_t height, uint16_t x, uint16_t y)
 {
-    // partial frame command
-    uc8151_write(UC8151_PARTIAL_IN, NULL, 0);
+    uint8_t y1 = y / 8;
+    uint16_t size = height / 8;
 
-    uc8151_write(UC8151_PARTIAL_WINDOW, (uint8_t[]) {
-                                            // Start verical channel
-                                            (y & 0b11111000), // Ignore the last 3 bits
-                                            // End verical channel
-                                            (((y & 0b11111000) + height - 1) | 0b111),
-                                            // Start horizontal line [8]
-                                            (x >> 8),
-                                            // Start horizontal line [7:0]
-                                            (x),
-                                            // End horizontal line [8]
-                                            ((x + width - 1) >> 8),
-                                            // End horizontal line [7:0]
-                                            ((x + width - 1)),
-                                            // Scan inside + outside
-                                            (0x01),
-                                        },
-        7);
-
-    uc8151_write(UC8151_DATA_START_TRANSMISSION_2, data, (height * width) / 8);
+    if (!data || !width || !size || UC8151_WIDTH <= x || UC8151_LINE_SIZE <= y1) {
+        return;
+    }
 
-    // End partial frame
-    sleep_ms(2);
-    uc8151_write(UC8151_PARTIAL_OUT, NULL, 0);
+    uint16_t lines = MIN(width, UC8151_WIDTH - x);
+    uint16_t bytes = MIN(size, UC8151_LINE_SIZE - y1);
+    for (uint16_t i = 0; i < lines; i++) {
+        memcpy(&uc8151_fb[(x + i) * UC8151_LINE_SIZE + y1], &data[i * size], bytes);
+    }
+    uc8151_mark_dirty(x, x + lines - 1, y1, y1 + bytes - 1);
 }
 
 /**
- * @brief Draws a rectangle to the screen SRAM. A refresh command needs to be sent to update the display.
+ * @brief Draws a rectangle to the framebuffer. A refresh command needs to be sent to update the display.
  *
  * @param x1
  * @param y1
@@ -282,78 +799,118 @@ void uc8151_draw_bitmap(uint8_t* data, uint16_t width, uint16_t height, uint16_t
  */
 void uc8151_fill_rectangle(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint8_t colour)
 {
-    uint16_t width = x2 - x1;
-    uint16_t height = y2 - y1;
-
-    // partial frame command
-    uc8151_write(UC8151_PARTIAL_IN, NULL, 0);
-
-    uc8151_write(UC8151_PARTIAL_WINDOW, (uint8_t[]) {
-                                            // Start verical channel
-                                            (y1 & 0b11111000), // Ignore the last 3 bits
-                                            // End verical channel
-                                            (((y1 & 0b11111000) + height - 1) | 0b111),
-                                            // Start horizontal line [8]
-                                            (x1 >> 8),
-                                            // Start horizontal line [7:0]
-                                            (x1),
-                                            // End horizontal line [8]
-                                            ((x1 + width - 1) >> 8),
-                                            // End horizontal line [7:0]
-                                            ((x1 + width - 1)),
-                                            // Scan inside + outside
-                                            (0x01),
-                                        },
-        7);
+    x2 = MIN(x2, UC8151_WIDTH);
+    y2 = MIN(y2, UC8151_HEIGHT);
 
-    uc8151_fill(UC8151_DATA_START_TRANSMISSION_2, colour, width * height / 8);
+    if (x1 >= x2 || y1 >= y2) {
+        return;
+    }
 
-    // End partial frame
-    sleep_ms(2);
-    uc8151_write(UC8151_PARTIAL_OUT, NULL, 0);
+    uint8_t first = y1 / 8;
+    uint8_t last = (y2 - 1) / 8;
+    for (uint16_t x = x1; x < x2; x++) {
+        memset(&uc8151_fb[x * UC8151_LINE_SIZE + first], colour, last - first + 1);
+    }
+    uc8151_mark_dirty(x1, x2 - 1, first, last);
 }
 
 /**
- * @brief Clears the frame data from the display RAM
+ * @brief Clears the framebuffer
  *
  */
 void uc8151_clear()
 {
-    uc8151_fill(UC8151_DATA_START_TRANSMISSION_2, 0xFF, UC8151_WIDTH * UC8151_HEIGHT / 8);
+    memset(uc8151_fb, 0xFF, sizeof(uc8151_fb));
+    uc8151_mark_dirty(0, UC8151_WIDTH - 1, 0, UC8151_LINE_SIZE - 1);
 }
 
 /**
- * @brief Update the display RAM with a bitmap
+ * @brief Update the framebuffer with a full screen bitmap
  *
  */
 void uc8151_update(uint8_t* data)
 {
-    uc8151_write(UC8151_DATA_START_TRANSMISSION_2, data, UC8151_WIDTH * UC8151_HEIGHT / 8);
+    memcpy(uc8151_fb, data, sizeof(uc8151_fb));
+    uc8151_mark_dirty(0, UC8151_WIDTH - 1, 0, UC8151_LINE_SIZE - 1);
 }
 
 /**
- * @brief Puts the data in RAM on to the display.
+ * @brief Puts the framebuffer on to the display in the background.
+ *
+ * Sends only the windows changed since the last refresh then refreshes the display.
+ * Drawing can continue meanwhile, it is sent on the next refresh.
  *
- * Refreshes the display
+ * @param cbk called from interrupt when the display has refreshed, NULL for none
+ */
+void uc8151_refresh_async(uc8151_done_cbk_t cbk)
+{
+    bool full = UC8151_UPDATE_FULL == uc8151_mode || (uc8151_full_every && uc8151_partials >= uc8151_full_every);
+
+    if (UC8151_UPDATE_PARTIAL == uc8151_mode && !full) {
+        if (!uc8151_dirty_count) {
+            // Nothing changed
+            if (cbk) {
+                cbk();
+            }
+            return;
+        }
+        uc8151_load_waveform(UC8151_UPDATE_PARTIAL);
+        uc8151_flush(true, cbk);
+        uc8151_partials++;
+    } else {
+        if (!uc8151_ram_valid) {
+            uc8151_mark_dirty(0, UC8151_WIDTH - 1, 0, UC8151_LINE_SIZE - 1);
+            uc8151_ram_valid = true;
+        }
+        uc8151_load_waveform(full ? UC8151_UPDATE_FULL : uc8151_mode);
+        uc8151_flush(false, NULL);
+        uc8151_queue_op(UC8151_DISPLAY_REFRESH, NULL, 0, 0, 0, UC8151_OP_BUSY, cbk);
+        if (full) {
+            uc8151_partials = 0;
+        } else {
+            uc8151_partials++;
+        }
+    }
+}
+
+/**
+ * @brief Puts the framebuffer on to the display.
+ *
+ * Sends only the windows changed since the last refresh then refreshes the display
  */
 void uc8151_refresh()
 {
-    uc8151_write(UC8151_DISPLAY_REFRESH, NULL, 0);
-    sleep_ms(100);
+    uc8151_refresh_async(NULL);
     uc8151_busy_wait();
 }
 
 /**
- * @brief Put the display to sleep.
+ * @brief Display is sending data or refreshing
+ *
+ * @return true
+ * @return false
+ */
+bool uc8151_busy()
+{
+    return uc8151_running;
+}
+
+/**
+ * @brief Wait for the queued commands and refresh to complete
+ *
+ */
+void uc8151_wait()
+{
+    uc8151_busy_wait();
+}
+
+/**
+ * @brief Put the display to sleep once the queued commands are done.
  *
  * Wake the device using uc8151_init()
  */
 void uc8151_sleep()
 {
-    uc8151_write(UC8151_POWER_OFF, NULL, 0);
-    uc8151_busy_wait();
+    uc8151_queue_op(UC8151_POWER_OFF, NULL, 0, 0, 0, UC8151_OP_BUSY, NULL);
     uc8151_write(UC8151_DEEP_SLEEP, (uint8_t[]) { 0xA5 }, 1);
-    uc8151_busy_wait();
-    gpio_put(CS, 0);
-    gpio_put(DC, 0);
 }
@@ -11,18 +11,38 @@
 #ifndef __UC8151C_H__
 #define __UC8151C_H__
 
+#include <stdbool.h>
+#include <stdint.h>
+
 // Hard-coded dimensions of the display
 #define UC8151_WIDTH (296)
 #define UC8151_HEIGHT (128)
 
+typedef void (*uc8151_done_cbk_t)(void);
+
+/**
+ * @brief Display update modes
+ *
+ */
+typedef enum {
+    UC8151_UPDATE_FULL = 0, ///< OTP waveform, flashing full refresh
+    UC8151_UPDATE_FAST, ///< Register waveform, short flash of the whole display
+    UC8151_UPDATE_PARTIAL, ///< Register waveform, changed windows only without flashing
+    UC8151_UPDATE_MAX
+} uc8151_update_t;
+
 void uc8151_setup();
 void uc8151_init();
 void uc8151_reset();
+void uc8151_set_update(uc8151_update_t mode, uint8_t full_every);
 void uc8151_draw_bitmap(uint8_t* data, uint16_t width, uint16_t height, uint16_t x, uint16_t y);
 void uc8151_fill_rectangle(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint8_t colour);
 void uc8151_update(uint8_t* data);
 void uc8151_clear();
 void uc8151_refresh();
+void uc8151_refresh_async(uc8151_done_cbk_t cbk);
+bool uc8151_busy();
+void uc8151_wait();
 void uc8151_sleep();
 
 #endif /* __UC8151C_H__ */
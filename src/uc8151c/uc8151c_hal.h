@@ -0,0 +1,85 @@
+/**
+ * @file uc8151c_hal.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief UC8151C bus abstraction between the driver and the hardware or simulated panel
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+#ifndef __UC8151C_HAL_H__
+#define __UC8151C_HAL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Command registers available from the manufacturer documentation
+ */
+enum uc8151_reg {
+    UC8151_PANEL_SETTING = 0x00,
+    UC8151_POWER_SETTING = 0x01,
+    UC8151_POWER_OFF = 0x02,
+    UC8151_POWER_OFF_SEQUENCE_SETTING = 0x03,
+    UC8151_POWER_ON = 0x04,
+    UC8151_POWER_ON_MEASURE = 0x05,
+    UC8161_BOOSTER_SOFT_START = 0x06,
+    UC8151_DEEP_SLEEP = 0x07,
+    UC8151_DATA_START_TRANSMISSION_1 = 0x10,
+    UC8151_DATA_STOP = 0x11,
+    UC8151_DISPLAY_REFRESH = 0x12,
+    UC8151_DATA_START_TRANSMISSION_2 = 0x13,
+    UC8151_LUT_VCOM = 0x20,
+    UC8151_LUT_WW = 0x21,
+    UC8151_LUT_BW = 0x22,
+    UC8151_LUT_WB = 0x23,
+    UC8151_LUT_BB = 0x24,
+    UC8151_PLL_CONTROL = 0x30,
+    UC8151_TEMPERATURE_SENSOR_COMMAND = 0x40,
+    UC8151_TEMPERATURE_SENSOR_CALIBRATION = 0x41,
+    UC8151_TEMPERATURE_SENSOR_WRITE = 0x42,
+    UC8151_TEMPERATURE_SENSOR_READ = 0x43,
+    UC8151_VCOM_AND_DATA_INTERVAL_SETTING = 0x50,
+    UC8151_LOW_POWER_DETECTION = 0x51,
+    UC8151_TCON_SETTING = 0x60,
+    UC8151_TCON_RESOLUTION = 0x61,
+    UC8151_SOURCE_AND_GATE_START_SETTING = 0x62,
+    UC8151_GET_STATUS = 0x71,
+    UC8151_AUTO_MEASURE_VCOM = 0x80,
+    UC8151_VCOM_VALUE = 0x81,
+    UC8151_VCM_DC_SETTING_REGISTER = 0x82,
+    UC8151_PARTIAL_WINDOW = 0x90,
+    UC8151_PARTIAL_IN = 0x91,
+    UC8151_PARTIAL_OUT = 0x92,
+    UC8151_PROGRAM_MODE = 0xA0,
+    UC8151_ACTIVE_PROGRAMMING = 0xA1,
+    UC8151_READ_OTP = 0xA2,
+    UC8151_POWER_SAVING = 0xE3
+};
+
+// Implemented by the port
+void uc8151_hal_setup();
+void uc8151_hal_reset();
+void uc8151_hal_select(bool en);
+void uc8151_hal_command(uint8_t command);
+void uc8151_hal_stream(const uint8_t* data, uint16_t size, bool repeat);
+void uc8151_hal_stream_end();
+void uc8151_hal_park();
+void uc8151_hal_abort();
+bool uc8151_hal_busy();
+void uc8151_hal_busy_arm(bool en);
+void uc8151_hal_alarm(uint32_t ms);
+void uc8151_hal_alarm_cancel();
+uint32_t uc8151_hal_lock();
+void uc8151_hal_unlock(uint32_t state);
+uint32_t uc8151_hal_millis();
+void uc8151_hal_sleep_ms(uint32_t ms);
+
+// Called by the port, from interrupt on hardware
+void uc8151_stream_done();
+void uc8151_busy_released();
+void uc8151_busy_expired();
+
+#endif /* __UC8151C_HAL_H__ */
@@ -0,0 +1,371 @@
+/**
+ * @file uc8151c_pico.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief RP2040 bus for the UC8151C driver
+ *
+ * SPI with a DMA channel for the data, GPIO for the control lines and an interrupt on the BUSY pin.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/spi.h"
+#include "hardware/sync.h"
+#include "pico/stdlib.h"
+
+#include "uc8151c_hal.h"
+
+/* MACROS ****************************************/
+
+#define UC8151_SPI_PORT (spi0)
+
+/**
+ * @brief DMA interrupt shared with other users
+ *
+ */
+#define UC8151_DMA_IRQ (DMA_IRQ_1)
+
+/**
+ * @brief Alarms in a pool of our own when not set up on core 0
+ *
+ */
+#define UC8151_ALARM_POOL_SIZE (2)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief Interface pins with our standard defaults where appropriate
+ *
+ */
+enum pin {
+    A = 12,
+    B = 13,
+    C = 14,
+    D = 15,
+    E = 11,
+    UP = 15, // alias for D
+    DOWN = 11, // alias for E
+    USER = 23,
+    CS = 17,
+    CLK = 18,
+    MOSI = 19,
+    DC = 20,
+    RESET = 21,
+    BUSY = 26,
+    VBUS_DETECT = 24,
+    LED = 25,
+    BATTERY = 29,
+    ENABLE_3V3 = 10
+};
+
+/* FUNCTION PROTOTYPES ****************************************/
+
+/* GLOBAL VARIABLES ****************************************/
+
+/* LOCAL VARIABLES ****************************************/
+
+static spi_inst_t* spi = UC8151_SPI_PORT;
+
+/**
+ * @brief DMA channel feeding the SPI
+ *
+ */
+static int uc8151_dma = -1;
+
+/**
+ * @brief DMA channel configuration
+ *
+ */
+static dma_channel_config uc8151_dma_config;
+
+/**
+ * @brief BUSY timeout alarm
+ *
+ */
+static alarm_id_t uc8151_alarm = 0;
+
+/**
+ * @brief Alarm pool of the core the display was set up on, so the timeout runs next to the other driver interrupts
+ *
+ */
+static alarm_pool_t* uc8151_alarm_pool = NULL;
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief DMA interrupt handler
+ *
+ */
+static void uc8151_dma_irq()
+{
+    if (dma_channel_get_irq1_status(uc8151_dma)) {
+        dma_channel_acknowledge_irq1(uc8151_dma);
+        uc8151_stream_done();
+    }
+}
+
+/**
+ * @brief BUSY pin interrupt handler, the display released the pin
+ *
+ */
+static void uc8151_busy_irq()
+{
+    if (gpio_get_irq_event_mask(BUSY) & GPIO_IRQ_EDGE_RISE) {
+        gpio_acknowledge_irq(BUSY, GPIO_IRQ_EDGE_RISE);
+        gpio_set_irq_enabled(BUSY, GPIO_IRQ_EDGE_RISE, false);
+        uc8151_busy_released();
+    }
+}
+
+/**
+ * @brief BUSY timeout alarm callback
+ *
+ * @param id alarm
+ * @param user_data unused
+ * @return int64_t 0 to not reschedule
+ */
+static int64_t uc8151_alarm_cb(alarm_id_t id, void* user_data)
+{
+    (void)id;
+    (void)user_data;
+
+    uc8151_alarm = 0;
+    uc8151_busy_expired();
+    return 0;
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Setup ports for UC8151C
+ *
+ */
+void uc8151_hal_setup()
+{
+    // configure spi interface and pins
+    spi_init(spi, 12000000);
+
+    // The default alarm pool interrupts core 0
+    if (!uc8151_alarm_pool) {
+        uc8151_alarm_pool = get_core_num() ? alarm_pool_create_with_unused_hardware_alarm(UC8151_ALARM_POOL_SIZE)
+                                           : alarm_pool_get_default();
+    }
+
+    // SPI transmit DMA, completion continues the command queue
+    uc8151_dma = dma_claim_unused_channel(true);
+    uc8151_dma_config = dma_channel_get_default_config(uc8151_dma);
+    channel_config_set_transfer_data_size(&uc8151_dma_config, DMA_SIZE_8);
+    channel_config_set_write_increment(&uc8151_dma_config, false);
+    channel_config_set_dreq(&uc8151_dma_config, spi_get_dreq(spi, true));
+    irq_add_shared_handler(UC8151_DMA_IRQ, uc8151_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    dma_channel_set_irq1_enabled(uc8151_dma, true);
+    irq_set_enabled(UC8151_DMA_IRQ, true);
+
+    // SET control pins for the display HIGH (they are active LOW)
+    gpio_set_function(DC, GPIO_FUNC_SIO);
+    gpio_set_dir(DC, GPIO_OUT);
+
+    gpio_set_function(CS, GPIO_FUNC_SIO);
+    gpio_set_dir(CS, GPIO_OUT);
+    gpio_put(CS, 1);
+
+    // Bring the RESX pin HIGH.
+    gpio_set_function(RESET, GPIO_FUNC_SIO);
+    gpio_set_dir(RESET, GPIO_OUT);
+    gpio_put(RESET, 1);
+
+    //**make sure to set the BUSY pin as INPUT in your main setup**
+    gpio_set_function(BUSY, GPIO_FUNC_SIO);
+    gpio_set_dir(BUSY, GPIO_IN);
+    gpio_set_pulls(BUSY, true, false);
+
+    // Raw handler so the application keeps its own GPIO callback
+    gpio_add_raw_irq_handler(BUSY, uc8151_busy_irq);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    gpio_set_function(CLK, GPIO_FUNC_SPI);
+    gpio_set_function(MOSI, GPIO_FUNC_SPI);
+}
+
+/**
+ * @brief Cycle the reset pin
+ *
+ */
+void uc8151_hal_reset()
+{
+    gpio_put(RESET, 0);
+    sleep_ms(10);
+    gpio_put(RESET, 1);
+    sleep_ms(10);
+}
+
+/**
+ * @brief Drive chip select
+ *
+ * @param en select the display
+ */
+void uc8151_hal_select(bool en)
+{
+    gpio_put(CS, !en);
+}
+
+/**
+ * @brief Send a command byte and switch to data mode
+ *
+ * @param command command register
+ */
+void uc8151_hal_command(uint8_t command)
+{
+    // Pull the command line LOW
+    gpio_put(DC, 0); // command mode
+
+    // Send data to the SPI register
+    spi_write_blocking(spi, &command, 1);
+
+    // CMD pin HIGH
+    gpio_put(DC, 1); // data mode
+}
+
+/**
+ * @brief Start streaming data, uc8151_stream_done() is called from the DMA interrupt when done
+ *
+ * @param data source
+ * @param size bytes to send
+ * @param repeat send the first byte size times
+ */
+void uc8151_hal_stream(const uint8_t* data, uint16_t size, bool repeat)
+{
+    channel_config_set_read_increment(&uc8151_dma_config, !repeat);
+    dma_channel_configure(uc8151_dma, &uc8151_dma_config, &spi_get_hw(spi)->dr, data, size, true);
+}
+
+/**
+ * @brief Wait for the last bytes to leave the SPI
+ *
+ */
+void uc8151_hal_stream_end()
+{
+    while (spi_is_busy(spi)) {
+        tight_loop_contents();
+    }
+
+    // Drop what was clocked in
+    while (spi_is_readable(spi)) {
+        (void)spi_get_hw(spi)->dr;
+    }
+    spi_get_hw(spi)->icr = SPI_SSPICR_RORIC_BITS;
+}
+
+/**
+ * @brief Pull the interface LOW so the sleeping controller is not powered through it
+ *
+ */
+void uc8151_hal_park()
+{
+    gpio_put(CS, 0);
+    gpio_put(DC, 0);
+}
+
+/**
+ * @brief Stop any transfer in progress
+ *
+ */
+void uc8151_hal_abort()
+{
+    dma_channel_abort(uc8151_dma);
+    uc8151_hal_busy_arm(false);
+    uc8151_hal_alarm_cancel();
+    gpio_put(CS, 1);
+}
+
+/**
+ * @brief Display holds the BUSY pin LOW
+ *
+ * @return true
+ * @return false
+ */
+bool uc8151_hal_busy()
+{
+    return !gpio_get(BUSY);
+}
+
+/**
+ * @brief Watch for the display releasing the BUSY pin, calls uc8151_busy_released()
+ *
+ * @param en enable
+ */
+void uc8151_hal_busy_arm(bool en)
+{
+    gpio_acknowledge_irq(BUSY, GPIO_IRQ_EDGE_RISE);
+    gpio_set_irq_enabled(BUSY, GPIO_IRQ_EDGE_RISE, en);
+}
+
+/**
+ * @brief Start the BUSY timeout, calls uc8151_busy_expired()
+ *
+ * @param ms timeout
+ */
+void uc8151_hal_alarm(uint32_t ms)
+{
+    uc8151_alarm = alarm_pool_add_alarm_in_ms(uc8151_alarm_pool, ms, uc8151_alarm_cb, NULL, true);
+}
+
+/**
+ * @brief Cancel the BUSY timeout
+ *
+ */
+void uc8151_hal_alarm_cancel()
+{
+    if (uc8151_alarm > 0) {
+        alarm_pool_cancel_alarm(uc8151_alarm_pool, uc8151_alarm);
+        uc8151_alarm = 0;
+    }
+}
+
+/**
+ * @brief Keep the driver interrupts out
+ *
+ * @return uint32_t state for uc8151_hal_unlock()
+ */
+uint32_t uc8151_hal_lock()
+{
+    return save_and_disable_interrupts();
+}
+
+/**
+ * @brief Let the driver interrupts in again
+ *
+ * @param state from uc8151_hal_lock()
+ */
+void uc8151_hal_unlock(uint32_t state)
+{
+    restore_interrupts(state);
+}
+
+/**
+ * @brief Time since boot
+ *
+ * @return uint32_t ms
+ */
+uint32_t uc8151_hal_millis()
+{
+    return to_ms_since_boot(get_absolute_time());
+}
+
+/**
+ * @brief Low power wait
+ *
+ * @param ms time to wait
+ */
+void uc8151_hal_sleep_ms(uint32_t ms)
+{
+    sleep_ms(ms);
+}
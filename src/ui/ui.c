@@ -0,0 +1,230 @@
+/**
+ * @file ui.c
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Retained screen widgets over the bitmap library
+ *
+ * Each widget remembers what it last drew and is only redrawn when that changes, so a refresh only sends the widgets
+ * that changed. What a widget drew before and no longer covers is blanked.
+ *
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+/* INCLUDES ****************************************/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bm.h"
+#include "uc8151c.h"
+#include "ui.h"
+
+/* MACROS ****************************************/
+
+#define UI_TEXT_SIZE (80)
+
+/* TYPES ****************************************/
+
+/**
+ * @brief What a widget draws
+ *
+ */
+typedef enum {
+    UI_KIND_TEXT,
+    UI_KIND_QR,
+    UI_KIND_ASSET,
+} ui_kind_t;
+
+/**
+ * @brief Widget position and kind
+ *
+ */
+typedef struct {
+    ui_kind_t kind; ///< What is drawn
+    bm_font_t font; ///< Font of text widgets
+    uint16_t x; ///< Left
+    uint16_t y; ///< Top, multiple of 8
+} ui_layout_t;
+
+/**
+ * @brief What a widget last drew
+ *
+ */
+typedef struct {
+    char text[UI_TEXT_SIZE]; ///< Text or QR code text
+    bm_asset_t asset; ///< Asset, BM_ASSET_MAX for none
+    uint16_t width; ///< Columns drawn
+    uint16_t height; ///< Rows drawn
+} ui_state_t;
+
+/* LOCAL VARIABLES ****************************************/
+
+/**
+ * @brief Screen layout
+ *
+ */
+static const ui_layout_t ui_layout[UI_MAX] = {
+    [UI_TITLE] = { UI_KIND_TEXT, BM_FONT_MONOSPACE, 0, 0 },
+    [UI_QR] = { UI_KIND_QR, 0, 0, 32 },
+    [UI_URL] = { UI_KIND_TEXT, BM_FONT_SMALL, 0, UC8151_HEIGHT - 8 },
+    [UI_TEMP] = { UI_KIND_TEXT, BM_FONT_MONOSPACE, 96, 32 },
+    [UI_TIME] = { UI_KIND_TEXT, BM_FONT_MONOSPACE, 96, 64 },
+    [UI_MODE] = { UI_KIND_ASSET, 0, UC8151_WIDTH - 32, 48 },
+    [UI_OUTPUT] = { UI_KIND_ASSET, 0, UC8151_WIDTH - 32, 88 },
+};
+
+/**
+ * @brief Widget contents
+ *
+ */
+static ui_state_t ui_state[UI_MAX];
+
+/* LOCAL FUNCTIONS ****************************************/
+
+/**
+ * @brief Blank what the widget drew before outside the new size and remember the new size
+ *
+ * @param widget
+ * @param width columns now drawn
+ * @param height rows now drawn
+ */
+static void ui_resize(ui_widget_t widget, uint16_t width, uint16_t height)
+{
+    const ui_layout_t* layout = &ui_layout[widget];
+    ui_state_t* state = &ui_state[widget];
+
+    if (state->width > width && state->height) {
+        bm_draw_blank(layout->x + width, layout->y, state->width - width, state->height);
+    }
+    if (state->height > height && width) {
+        bm_draw_blank(layout->x, layout->y + height, width < state->width ? width : state->width, state->height - height);
+    }
+    state->width = width;
+    state->height = height;
+}
+
+/**
+ * @brief Check a widget can draw this kind of content
+ *
+ * @param widget
+ * @param kind
+ * @return true
+ * @return false
+ */
+static bool ui_valid(ui_widget_t widget, ui_kind_t kind)
+{
+    if (UI_MAX <= widget || kind != ui_layout[widget].kind) {
+        printf("Invalid widget\n");
+        return false;
+    }
+    return true;
+}
+
+/* GLOBAL FUCNTIONS ****************************************/
+
+/**
+ * @brief Forget the widget contents, call after clearing the display
+ *
+ */
+void ui_init()
+{
+    memset(ui_state, 0, sizeof(ui_state));
+    for (uint8_t i = 0; i < UI_MAX; i++) {
+        ui_state[i].asset = BM_ASSET_MAX;
+    }
+}
+
+/**
+ * @brief Show text in a text widget
+ *
+ * @param widget
+ * @param fmt
+ * @param ...
+ * @return true redrawn
+ * @return false unchanged or invalid
+ */
+bool ui_text(ui_widget_t widget, const char* fmt, ...)
+{
+    bool changed = false;
+    if (fmt && ui_valid(widget, UI_KIND_TEXT)) {
+        const ui_layout_t* layout = &ui_layout[widget];
+        ui_state_t* state = &ui_state[widget];
+        char text[UI_TEXT_SIZE] = "";
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(text, sizeof(text), fmt, args);
+        va_end(args);
+
+        if (strcmp(text, state->text)) {
+            bm_font_draw_string(layout->font, layout->x, layout->y, text);
+            ui_resize(widget, bm_font_width(layout->font, text), bm_fonts[layout->font].height);
+            strcpy(state->text, text);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief Show a QR code in a QR widget
+ *
+ * @param widget
+ * @param fmt
+ * @param ...
+ * @return true redrawn
+ * @return false unchanged or invalid
+ */
+bool ui_qr(ui_widget_t widget, const char* fmt, ...)
+{
+    bool changed = false;
+    if (fmt && ui_valid(widget, UI_KIND_QR)) {
+        const ui_layout_t* layout = &ui_layout[widget];
+        ui_state_t* state = &ui_state[widget];
+        char text[UI_TEXT_SIZE] = "";
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(text, sizeof(text), fmt, args);
+        va_end(args);
+
+        if (strcmp(text, state->text)) {
+            uint16_t size = bm_qr_printf(layout->x, layout->y, "%s", text);
+            ui_resize(widget, size, size);
+            strcpy(state->text, text);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief Show an asset in an asset widget
+ *
+ * @param widget
+ * @param asset BM_ASSET_MAX to blank the widget
+ * @return true redrawn
+ * @return false unchanged or invalid
+ */
+bool ui_asset(ui_widget_t widget, bm_asset_t asset)
+{
+    bool changed = false;
+    if (ui_valid(widget, UI_KIND_ASSET)) {
+        const ui_layout_t* layout = &ui_layout[widget];
+        ui_state_t* state = &ui_state[widget];
+
+        if (asset != state->asset) {
+            if (BM_ASSET_MAX > asset) {
+                bm_asset_draw(asset, layout->x, layout->y);
+                ui_resize(widget, bm_assets[asset].width, bm_assets[asset].height);
+            } else {
+                ui_resize(widget, 0, 0);
+            }
+            state->asset = asset;
+            changed = true;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file ui.h
+ * @author Arijit Sadhu (arijitsadhu@users.noreply.github.com)
+ * @brief Refer to .c file
+ * @version 0.1
+ * @date 2024-03-05
+ *
+ * @copyright Copyright (c) 2024 Arijit Sadhu
+ *
+ */
+
+#ifndef __UI_H__
+#define __UI_H__
+
+#include <stdbool.h>
+
+#include "bm.h"
+
+/**
+ * @brief Screen widgets
+ *
+ */
+typedef enum {
+    UI_TITLE, ///< Device name
+    UI_QR, ///< Wi-Fi or URL QR code
+    UI_URL, ///< Device URL
+    UI_TEMP, ///< Temperature or thermostat setting
+    UI_TIME, ///< Time
+    UI_MODE, ///< Mode icon
+    UI_OUTPUT, ///< Output icon
+    UI_MAX
+} ui_widget_t;
+
+void ui_init();
+bool ui_text(ui_widget_t widget, const char* fmt, ...);
+bool ui_qr(ui_widget_t widget, const char* fmt, ...);
+bool ui_asset(ui_widget_t widget, bm_asset_t asset);
+
+#endif /* __UI_H__ */
@@ -0,0 +1,345 @@
+#!/usr/bin/perl
+#
+# bmassets.pl - generate the bm asset table
+#
+# Reads the BMP, PNG or XBM images in the assets directory and the fonts in assets/fonts and writes:
+#   bm_assets.h  an enum handle per asset, BM_ASSET_<NAME>, and per font, BM_FONT_<NAME>
+#   bm_assets.c  the pixels in the display column-major raster with the width and height already parsed, and the fonts
+#
+# So drawing an asset is a table lookup with no file system walk or header parsing on the device.
+#
+# Images are drawn upright as they are to be seen on the display. Each is made black and white at half brightness,
+# transparent PNG pixels are white, and packed a column at a time with the top pixel in the most significant bit and
+# set bits white, the height padded to 8 with white. This is the rotation and inversion the panel needs so the sources
+# are never rotated by hand. BMP can be 1, 4, 8, 24 or 32 bits, PNG any non interlaced colour type and XBM is black on
+# white.
+#
+# Font sources are the usual strip of the 95 printable characters from ' ', each glyph the same width. Glyphs are
+# trimmed to their inked columns plus one blank column, except for fonts named mono* which keep the fixed width, and a
+# blank glyph is half the width. Each glyph is then stored as runs of pixels down the columns, starting white and
+# alternating colour, one run per nibble with the high nibble first. A nibble of 15 is 15 pixels without changing
+# colour. Glyphs start on a byte. When that is no smaller than the glyph columns as they are, as for small fonts, the
+# columns are stored packed one glyph after another without the offset table.
+#
+# Usage: perl bmassets.pl <assets directory> <output directory>
+#
+# Copyright (c) 2024 Arijit Sadhu
+#
+
+use strict;
+use warnings;
+
+use Compress::Zlib;
+use File::Basename;
+
+my ($src, $dst) = @ARGV;
+die "Usage: $0 <assets directory> <output directory>\n" unless defined $src && defined $dst;
+
+# Black or white of a colour, white from half brightness
+sub white {
+    my ($r, $g, $b) = @_;
+    return (($r * 77 + $g * 150 + $b * 29) >> 8) >= 128 ? 1 : 0;
+}
+
+# Read a BMP, returns the width, height and rows of pixels from the top, 1 is white
+sub read_bmp {
+    my ($path) = @_;
+
+    open(my $fh, '<:raw', $path) or die "$path: $!\n";
+    local $/;
+    my $file = <$fh>;
+    close($fh);
+
+    my ($type, $offset) = unpack('a2 x8 V', $file);
+    die "$path: not a BMP file\n" unless 'BM' eq $type;
+    my ($dib, $width, $height, $planes, $bpp, $compression, $size, $xppm, $yppm, $colors) = unpack('x14 V l< l< v v V V l< l< V', $file);
+    die "$path: only uncompressed 1, 4, 8, 24 or 32 bit BMP is supported\n"
+        unless 0 == $compression && grep { $bpp == $_ } 1, 4, 8, 24, 32;
+
+    # Palette entries are BGRA
+    my @palette;
+    if ($bpp <= 8) {
+        $colors ||= 1 << $bpp;
+        @palette = map { white(reverse unpack('C3', substr($file, 14 + $dib + $_ * 4, 3))) } 0 .. $colors - 1;
+    }
+
+    # Rows are padded to 4 bytes and bottom-up unless the height is negative
+    my $row = int(($width * $bpp + 31) / 32) * 4;
+    my $lines = abs($height);
+    my @rows;
+    for my $y (0 .. $lines - 1) {
+        my $data = substr($file, $offset + ($height < 0 ? $y : $lines - 1 - $y) * $row, $row);
+        my @pixels;
+        if ($bpp <= 8) {
+            my @bits = split(//, unpack('B*', $data));
+            @pixels = map { $palette[oct('0b' . join('', @bits[$_ * $bpp .. ($_ + 1) * $bpp - 1]))] // 0 } 0 .. $width - 1;
+        } else {
+            my $step = $bpp / 8;
+            @pixels = map { white(reverse unpack('C3', substr($data, $_ * $step, 3))) } 0 .. $width - 1;
+        }
+        push(@rows, \@pixels);
+    }
+
+    return ($width, $lines, \@rows);
+}
+
+# Read an XBM, set bit is black with the first pixel of each row in the least significant bit
+sub read_xbm {
+    my ($path) = @_;
+
+    open(my $fh, '<', $path) or die "$path: $!\n";
+    local $/;
+    my $file = <$fh>;
+    close($fh);
+
+    my ($width) = $file =~ /#define\s+\w+_width\s+(\d+)/ or die "$path: no width\n";
+    my ($height) = $file =~ /#define\s+\w+_height\s+(\d+)/ or die "$path: no height\n";
+    my ($bits) = $file =~ /\{(.*)\}/s or die "$path: no bits\n";
+    my @data = map { hex($_) } $bits =~ /0x([0-9a-fA-F]+)/g;
+    my $row = int(($width + 7) / 8);
+    die "$path: expected " . ($row * $height) . " bytes\n" unless @data == $row * $height;
+
+    my @rows;
+    for my $y (0 .. $height - 1) {
+        push(@rows, [ map { ($data[$y * $row + int($_ / 8)] >> ($_ % 8)) & 1 ? 0 : 1 } 0 .. $width - 1 ]);
+    }
+
+    return ($width, $height, \@rows);
+}
+
+# Read a non interlaced PNG, transparent pixels are white
+sub read_png {
+    my ($path) = @_;
+
+    open(my $fh, '<:raw', $path) or die "$path: $!\n";
+    local $/;
+    my $file = <$fh>;
+    close($fh);
+
+    die "$path: not a PNG file\n" unless "\x89PNG\r\n\x1a\n" eq substr($file, 0, 8);
+    my ($width, $height, $depth, $type, $interlace, @palette, @alpha);
+    my $idat = '';
+    for (my $pos = 8; $pos + 8 <= length($file);) {
+        my ($len, $chunk) = unpack('N a4', substr($file, $pos, 8));
+        my $data = substr($file, $pos + 8, $len);
+        $pos += 12 + $len;
+        if ('IHDR' eq $chunk) {
+            ($width, $height, $depth, $type, undef, undef, $interlace) = unpack('N N C C C C C', $data);
+        } elsif ('PLTE' eq $chunk) {
+            @palette = map { [ unpack('C3', substr($data, $_ * 3, 3)) ] } 0 .. $len / 3 - 1;
+        } elsif ('tRNS' eq $chunk) {
+            @alpha = unpack('C*', $data);
+        } elsif ('IDAT' eq $chunk) {
+            $idat .= $data;
+        } elsif ('IEND' eq $chunk) {
+            last;
+        }
+    }
+    die "$path: no image header\n" unless defined $width;
+    die "$path: interlaced PNG is not supported\n" if $interlace;
+
+    my $raw = uncompress($idat) // die "$path: bad image data\n";
+    my $channels = { 0 => 1, 2 => 3, 3 => 1, 4 => 2, 6 => 4 }->{$type} // die "$path: unknown colour type\n";
+    my $bpp = $channels * $depth;
+    my $stride = int(($width * $bpp + 7) / 8);
+    my $pixel = $bpp >= 8 ? $bpp / 8 : 1;
+    my $max = (1 << $depth) - 1;
+
+    my @rows;
+    my @prev = (0) x $stride;
+    for my $y (0 .. $height - 1) {
+        my ($filter, @line) = unpack('C*', substr($raw, $y * ($stride + 1), $stride + 1));
+        for my $i (0 .. $stride - 1) {
+            my $a = $i >= $pixel ? $line[$i - $pixel] : 0;
+            my $b = $prev[$i];
+            my $c = $i >= $pixel ? $prev[$i - $pixel] : 0;
+            if (1 == $filter) {
+                $line[$i] += $a;
+            } elsif (2 == $filter) {
+                $line[$i] += $b;
+            } elsif (3 == $filter) {
+                $line[$i] += ($a + $b) >> 1;
+            } elsif (4 == $filter) {
+                my ($pa, $pb, $pc) = (abs($b - $c), abs($a - $c), abs($a + $b - 2 * $c));
+                $line[$i] += $pa <= $pb && $pa <= $pc ? $a : $pb <= $pc ? $b : $c;
+            }
+            $line[$i] &= 0xff;
+        }
+        @prev = @line;
+
+        # Samples scaled to 8 bits, 16 bit samples use the high byte
+        my @bits = split(//, unpack('B*', pack('C*', @line)));
+        my @samples = $depth < 8 ? map { oct('0b' . join('', @bits[$_ * $depth .. ($_ + 1) * $depth - 1])) } 0 .. $width * $channels - 1
+            : map { $line[$_ * $depth / 8] } 0 .. $width * $channels - 1;
+        my @pixels;
+        for my $x (0 .. $width - 1) {
+            my @s = @samples[$x * $channels .. ($x + 1) * $channels - 1];
+            my ($rgb, $opaque);
+            if (3 == $type) {
+                $rgb = $palette[ $s[0] ] // [ 0, 0, 0 ];
+                $opaque = ($alpha[ $s[0] ] // 255) >= 128;
+            } else {
+                @s = map { $_ * 255 / $max } @s if $depth < 8;
+                $rgb = $channels >= 3 ? [ @s[0 .. 2] ] : [ ($s[0]) x 3 ];
+                $opaque = 2 == $channels || 4 == $channels ? $s[-1] >= 128 : 1;
+            }
+            push(@pixels, $opaque ? white(@$rgb) : 1);
+        }
+        push(@rows, \@pixels);
+    }
+
+    return ($width, $height, \@rows);
+}
+
+# Read an upright image and pack it into the display column-major raster, returns the width, height padded to 8
+# and the bytes of each column in turn with the top pixel in the most significant bit, set bit is white
+sub read_image {
+    my ($path) = @_;
+    my ($width, $height, $rows) = $path =~ /\.xbm$/i ? read_xbm($path) : $path =~ /\.png$/i ? read_png($path) : read_bmp($path);
+    my $line = int(($height + 7) / 8);
+
+    my @data;
+    for my $x (0 .. $width - 1) {
+        for my $band (0 .. $line - 1) {
+            my $byte = 0;
+            for my $bit (0 .. 7) {
+                my $y = $band * 8 + $bit;
+                $byte |= 0x80 >> $bit if $y >= $height || $rows->[$y][$x];
+            }
+            push(@data, $byte);
+        }
+    }
+
+    return ($width, $line * 8, \@data);
+}
+
+# Convert a strip of fixed width glyphs, returns the data, glyph offsets or undef when packed, and advance widths
+sub font_encode {
+    my ($path, $columns, $height, $data, $fixed) = @_;
+    my $line = $height / 8;
+    my $cell = int($columns / 95);
+    die "$path: not 95 glyphs\n" unless $cell;
+
+    my (@out, @offset, @advance, @packed);
+    for my $glyph (0 .. 94) {
+        my @cols = map { [ @$data[($glyph * $cell + $_) * $line .. ($glyph * $cell + $_ + 1) * $line - 1] ] } 0 .. $cell - 1;
+
+        unless ($fixed) {
+            my @inked = grep { grep { 0xff != $_ } @{ $cols[$_] } } 0 .. $#cols;
+            if (@inked) {
+                @cols = (@cols[$inked[0] .. $inked[-1]], [ (0xff) x $line ]);
+            } else {
+                @cols = map { [ (0xff) x $line ] } 1 .. ($cell > 1 ? int($cell / 2) : 1);
+            }
+        }
+
+        push(@packed, map {@$_} @cols);
+
+        # Pixel runs down the columns, starting white
+        my @runs;
+        my ($colour, $run) = (1, 0);
+        for my $byte (map {@$_} @cols) {
+            for my $bit (reverse 0 .. 7) {
+                my $pixel = ($byte >> $bit) & 1;
+                if ($pixel != $colour) {
+                    push(@runs, $run);
+                    ($colour, $run) = ($pixel, 0);
+                }
+                $run++;
+            }
+        }
+        push(@runs, $run) if 0 == $colour;
+
+        my @nibbles;
+        for my $run (@runs) {
+            while ($run >= 15) {
+                push(@nibbles, 15);
+                $run -= 15;
+            }
+            push(@nibbles, $run);
+        }
+        push(@nibbles, 15) if @nibbles % 2;
+
+        push(@offset, scalar(@out));
+        push(@advance, scalar(@cols));
+        push(@out, $nibbles[$_] << 4 | $nibbles[$_ + 1]) for grep { 0 == $_ % 2 } 0 .. $#nibbles;
+    }
+    push(@offset, scalar(@out));
+
+    if (@packed <= @out + 2 * @offset) {
+        return (\@packed, undef, \@advance);
+    }
+    return (\@out, \@offset, \@advance);
+}
+
+# Write a C array body, 12 bytes per line
+sub c_bytes {
+    my ($data, $format) = @_;
+    $format //= '0x%02x';
+    my $out = '';
+    for (my $i = 0; $i < @$data; $i += 12) {
+        my $end = $i + 11 < $#$data ? $i + 11 : $#$data;
+        $out .= '    ' . join(', ', map { sprintf($format, $_) } @$data[$i .. $end]) . ",\n";
+    }
+    return $out;
+}
+
+opendir(my $dh, $src) or die "$src: $!\n";
+my @files = sort grep { /\.(bmp|png|xbm)$/i } readdir($dh);
+closedir($dh);
+
+my @assets;
+for my $file (@files) {
+    my $name = lc(fileparse($file, qr/\.[^.]*/));
+    $name =~ s/[^a-z0-9]/_/g;
+    my ($width, $height, $data) = read_image("$src/$file");
+    push(@assets, { name => $name, file => $file, width => $width, height => $height, data => $data });
+}
+
+my @fonts;
+if (opendir(my $fonts, "$src/fonts")) {
+    for my $file (sort grep { /\.(bmp|png|xbm)$/i } readdir($fonts)) {
+        my $name = lc(fileparse($file, qr/\.[^.]*/));
+        $name =~ s/[^a-z0-9]/_/g;
+        my ($columns, $height, $pixels) = read_image("$src/fonts/$file");
+        my ($data, $offset, $advance) = font_encode($file, $columns, $height, $pixels, scalar($name =~ /^mono/));
+        push(@fonts, { name => $name, file => $file, height => $height, data => $data, offset => $offset, advance => $advance });
+    }
+    closedir($fonts);
+}
+
+open(my $h, '>', "$dst/bm_assets.h") or die "$dst/bm_assets.h: $!\n";
+print $h "/* Generated by tools/bmassets.pl, do not edit */\n\n";
+print $h "#ifndef __BM_ASSETS_H__\n#define __BM_ASSETS_H__\n\n";
+print $h "/**\n * \@brief Display asset handles\n *\n */\ntypedef enum {\n";
+print $h "    BM_ASSET_" . uc($_->{name}) . ", ///< $_->{file}\n" for @assets;
+print $h "    BM_ASSET_MAX\n} bm_asset_t;\n\n";
+print $h "/**\n * \@brief Font handles\n *\n */\ntypedef enum {\n";
+print $h "    BM_FONT_" . uc($_->{name}) . ", ///< fonts/$_->{file}\n" for @fonts;
+print $h "    BM_FONT_MAX\n} bm_font_t;\n\n";
+print $h "#endif /* __BM_ASSETS_H__ */\n";
+close($h);
+
+open(my $c, '>', "$dst/bm_assets.c") or die "$dst/bm_assets.c: $!\n";
+print $c "/* Generated by tools/bmassets.pl, do not edit */\n\n";
+print $c "#include \"bm.h\"\n\n";
+for my $asset (@assets) {
+    print $c "static const uint8_t bm_asset_$asset->{name}\[\] = {\n" . c_bytes($asset->{data}) . "};\n\n";
+}
+print $c "const bm_asset_data_t bm_assets[BM_ASSET_MAX] = {\n";
+for my $asset (@assets) {
+    print $c "    [BM_ASSET_" . uc($asset->{name}) . "] = { bm_asset_$asset->{name}, $asset->{width}, $asset->{height} },\n";
+}
+print $c "};\n";
+for my $font (@fonts) {
+    print $c "\nstatic const uint8_t bm_font_$font->{name}_data[] = {\n" . c_bytes($font->{data}) . "};\n";
+    print $c "\nstatic const uint16_t bm_font_$font->{name}_offset[] = {\n" . c_bytes($font->{offset}, '%u') . "};\n" if $font->{offset};
+    print $c "\nstatic const uint8_t bm_font_$font->{name}_advance[] = {\n" . c_bytes($font->{advance}, '%u') . "};\n";
+}
+print $c "\nconst bm_font_data_t bm_fonts[BM_FONT_MAX] = {\n";
+for my $font (@fonts) {
+    my $offset = $font->{offset} ? "bm_font_$font->{name}_offset" : 'NULL';
+    print $c "    [BM_FONT_" . uc($font->{name}) . "] = { bm_font_$font->{name}_data, $offset, bm_font_$font->{name}_advance, $font->{height}, ' ', 95 },\n";
+}
+print $c "};\n";
+close($c);
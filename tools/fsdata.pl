@@ -0,0 +1,125 @@
+#!/usr/bin/perl
+#
+# fsdata.pl - generate the lwIP httpd file system
+#
+# Reads the files in the web directory and writes them as the makefsdata fsdata.c that httpd serves from flash, each
+# with its HTTP header already included:
+#   Content-Type     from the file extension
+#   Content-Length   of the body as sent
+#   ETag             strong, a hash of the body as sent so it only changes when the bytes do
+#   Cache-Control    no-cache for pages so they are checked each visit, a week for everything else
+#
+# Each file also has a second file of the same name with .304 added holding only the 304 Not Modified header with the
+# same ETag, served when the request If-None-Match has it so the body is not sent again.
+#
+# Text files (html, css, js, json, svg) are minified by dropping the indentation, trailing spaces and blank lines, which
+# keeps the line breaks so scripts are not changed. They are then also gzipped into a second file of the same name with
+# .gz added and Content-Encoding: gzip, served in its place to clients that accept gzip. Both then carry
+# Vary: Accept-Encoding for caches. The gzip has no name or time in it so the output only changes with the sources.
+#
+# Usage: perl fsdata.pl <web directory> <output file>
+#
+# Copyright (c) 2024 Arijit Sadhu
+#
+
+use strict;
+use warnings;
+
+use Digest::SHA qw(sha1_hex);
+use File::Find;
+use IO::Compress::Gzip qw(gzip $GzipError);
+
+my ($src, $dst) = @ARGV;
+die "Usage: $0 <web directory> <output file>\n" unless defined $src && defined $dst;
+
+my %types = (
+    html => 'text/html',
+    htm  => 'text/html',
+    css  => 'text/css',
+    js   => 'application/javascript',
+    json => 'application/json',
+    svg  => 'image/svg+xml',
+    txt  => 'text/plain',
+    bmp  => 'image/bmp',
+    png  => 'image/png',
+    gif  => 'image/gif',
+    jpg  => 'image/jpeg',
+    ico  => 'image/x-icon',
+);
+
+my %minify = map { $_ => 1 } qw(html htm css js json svg);
+
+# Strip the indentation, trailing spaces and blank lines
+sub minify {
+    my ($text) = @_;
+    return join('', map { s/^\s+|\s+$//gr . "\n" } grep { /\S/ } split(/\n/, $text));
+}
+
+# A file and its 304 Not Modified
+sub file {
+    my ($name, $body, $type, @extra) = @_;
+    my $etag = substr(sha1_hex($body), 0, 16);
+    my $cache = 'text/html' eq $type ? 'no-cache' : 'max-age=604800';
+    my @common = ('Server: lwIP/pre-0.6 (http://www.sics.se/~adam/lwip/)', "Cache-Control: $cache", "ETag: \"$etag\"");
+    my @vary = grep { /^Vary:/ } @extra;
+    return (
+        { name => $name, data => join("\r\n", 'HTTP/1.0 200 OK', "Content-Type: $type", 'Content-Length: ' . length($body), @extra, @common, '', '') . $body },
+        { name => "$name.304", data => join("\r\n", 'HTTP/1.0 304 Not Modified', @vary, @common, '', '') },
+    );
+}
+
+# Write a C array body, 16 bytes per line
+sub c_bytes {
+    my ($data) = @_;
+    my @bytes = unpack('C*', $data);
+    my $out = '';
+    while (my @line = splice(@bytes, 0, 16)) {
+        $out .= '    ' . join(', ', map { sprintf('0x%02x', $_) } @line) . ",\n";
+    }
+    return $out;
+}
+
+my @paths;
+find({ wanted => sub { push(@paths, $File::Find::name) if -f }, no_chdir => 1 }, $src);
+
+my @files;
+for my $path (sort @paths) {
+    my $name = substr($path, length($src)) =~ s{\\}{/}gr;
+    $name = "/$name" unless $name =~ m{^/};
+    my ($ext) = lc($name) =~ /\.([^.\/]*)$/;
+    $ext //= '';
+    my $type = $types{$ext} // 'application/octet-stream';
+
+    open(my $fh, '<:raw', $path) or die "$path: $!\n";
+    local $/;
+    my $body = <$fh>;
+    close($fh);
+
+    if ($minify{$ext}) {
+        $body = minify($body);
+        my $gz;
+        gzip(\$body => \$gz, Minimal => 1, Level => 9, Time => 0) or die "$path: $GzipError\n";
+        if (length($gz) < length($body)) {
+            push(@files, file($name, $body, $type, 'Vary: Accept-Encoding'));
+            push(@files, file("$name.gz", $gz, $type, 'Content-Encoding: gzip', 'Vary: Accept-Encoding'));
+            next;
+        }
+    }
+    push(@files, file($name, $body, $type));
+}
+
+open(my $c, '>', $dst) or die "$dst: $!\n";
+print $c "/* Generated by tools/fsdata.pl, do not edit */\n\n";
+my $prev = 'NULL';
+for my $file (@files) {
+    my $var = $file->{name} =~ s/[^A-Za-z0-9]/_/gr;
+    my $size = length($file->{name}) + 1;
+    print $c "/* $file->{name} */\n";
+    print $c "static const unsigned char data$var\[\] = {\n" . c_bytes("$file->{name}\0$file->{data}") . "};\n\n";
+    print $c "const struct fsdata_file file$var\[\] = { { $prev, data$var, data$var + $size, sizeof(data$var) - $size, "
+        . "FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_HEADER_PERSISTENT } };\n\n";
+    $prev = "file$var";
+}
+print $c "#define FS_ROOT $prev\n";
+print $c '#define FS_NUMFILES ' . scalar(@files) . "\n";
+close($c);